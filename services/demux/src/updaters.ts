@@ -1,5 +1,4 @@
 import { BlockInfo } from "demux"
-import moment from "moment"
 
 const createPet = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
@@ -106,6 +105,36 @@ const addAction = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
 }
 
+const PET_CARE_ACTIONS: { [op: number]: string } = {
+  1: "feedpet",
+  2: "bedpet",
+  3: "awakepet",
+}
+
+const petcarebatch = async (db: any, payload: any, blockInfo: BlockInfo) => {
+
+  console.info("\n\n==== Add Pet Care Batch Actions ====")
+  console.info("\n\nUpdater Payload >>> \n", payload)
+  console.info("\n\nUpdater Block Info >>> \n", blockInfo)
+
+  const data = payload.data.ops.map((careOp: any) => ({
+    pet_id: careOp.pet_id,
+    action: PET_CARE_ACTIONS[careOp.op],
+    is_invalid: false,
+    created_block: blockInfo.blockNumber,
+    created_trx: payload.transactionId,
+    created_at: blockInfo.timestamp,
+    created_eosacc: payload.authorization[0].actor,
+  }))
+
+  console.info("DB Data to Insert >>> ", data)
+
+  const res = await db.pet_actions.insert(data)
+
+  console.info("DB State Result >>> ", res)
+
+}
+
 const destroypet = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
   console.info("\n\n==== Destroy Pet ====")
@@ -148,25 +177,35 @@ const battlecreate = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
 }
 
+const findInlineAction = (payload: any, actionName: string) => {
+  const { act }: any = (payload.inlineActions || []).find(
+    ({act: inlineAct}: any) => inlineAct.account === "monstereosio" &&
+      inlineAct.name === actionName) || {}
+
+  return act
+}
+
 const quickbattle = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
   console.info("\n\n==== Quick Battle ====")
   console.info("\n\nUpdater Payload >>> \n", payload)
   console.info("\n\nUpdater Block Info >>> \n", blockInfo)
 
-  const lastBattle = await getLastBattle(db)
-  const startedBattleMinTime = new Date(2018, 0, 1).getTime()
-
-  // if last battle is already started, creates a new one
-  if (moment(lastBattle.started_at).valueOf() > startedBattleMinTime) {
+  const player = payload.authorization[0].actor
+  const joinAction = findInlineAction(payload, "battlejoined")
 
+  // paired with a waiting lobby, joins the battle of its host
+  if (joinAction && joinAction.data && joinAction.data.host) {
+    const battle = await getLastBattleByHost(db, joinAction.data.host)
+    await battleJoin(db, battle.id, payload.data.picks.pets, player, blockInfo, false)
+  } else { // no opponent waiting, opens a new lobby
     const data = {
-      host: payload.authorization[0].actor,
+      host: player,
       mode: payload.data.mode,
       created_block: blockInfo.blockNumber,
       created_trx: payload.transactionId,
       created_at: blockInfo.timestamp,
-      created_eosacc: payload.authorization[0].actor,
+      created_eosacc: player,
     }
 
     console.info("DB Data to Insert >>> ", data)
@@ -175,21 +214,10 @@ const quickbattle = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
     console.info("DB State Result >>> ", res)
 
-    await battleJoin(db, res.id, payload.data.picks.pets, payload.authorization[0].actor, blockInfo, true)
-
-  } else { // join in the current battle
-    await battleJoin(db, lastBattle.id, payload.data.picks.pets, payload.authorization[0].actor, blockInfo, false)
+    await battleJoin(db, res.id, payload.data.picks.pets, player, blockInfo, true)
   }
 }
 
-const getLastBattle = async (db: any) => {
-  return await db.battles.findOne({}, {
-    order: [
-      { field: "id", direction: "desc" },
-    ],
-  })
-}
-
 const getLastBattleByHost = async (db: any, host: string) => {
   return await db.battles.findOne({
     host,
@@ -275,9 +303,7 @@ const battleattack = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
   console.info("Checking battle winner...")
   if (payload.inlineActions && payload.inlineActions.length) {
-    const { act: finishAction }: any = payload.inlineActions.find(
-      ({act}: any) => act.account === "monstereosio" &&
-        act.name === "battlefinish") || {}
+    const finishAction = findInlineAction(payload, "battlefinish")
 
     if (finishAction && finishAction.data && finishAction.data.winner) {
       console.info("Battle has a winner: ", finishAction.data.winner)
@@ -295,6 +321,31 @@ const battleattack = async (db: any, payload: any, blockInfo: BlockInfo) => {
 
 }
 
+const battlesweep = async (db: any, payload: any, blockInfo: BlockInfo) => {
+
+  console.info("\n\n==== Battle Sweep ====")
+  console.info("\n\nUpdater Payload >>> \n", payload)
+  console.info("\n\nUpdater Block Info >>> \n", blockInfo)
+
+  // abandoned battles are finished through inline battlefinish actions
+  const finishActions = (payload.inlineActions || []).filter(
+    ({act}: any) => act.account === "monstereosio" &&
+      act.name === "battlefinish")
+
+  for (const { act: finishAction } of finishActions) {
+    if (finishAction.data && finishAction.data.winner) {
+      console.info("Abandoned battle winner: ", finishAction.data.host, finishAction.data.winner)
+
+      const battle = await getLastBattleByHost(db, finishAction.data.host)
+      await db.battles.update(
+        { id: battle.id },
+        { winner: finishAction.data.winner },
+      )
+    }
+  }
+
+}
+
 const updaters = [
   {
     actionType: "monstereosio::createpet",
@@ -320,6 +371,10 @@ const updaters = [
     actionType: "monstereosio::awakepet",
     updater: addAction,
   },
+  {
+    actionType: "monstereosio::petcarebatch",
+    updater: petcarebatch,
+  },
   {
     actionType: "monstereosio::destroypet",
     updater: destroypet,
@@ -340,6 +395,10 @@ const updaters = [
     actionType: "monstereosio::battleattack",
     updater: battleattack,
   },
+  {
+    actionType: "monstereosio::battlesweep",
+    updater: battlesweep,
+  },
 ]
 
 export { updaters }
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace utils {
+
+    // integer square root, floor(sqrt(n)), by Newton iterations
+    constexpr uint64_t isqrt(const uint64_t n) {
+        uint64_t x = n;
+        uint64_t y = n / 2 + (n & 1);
+        while (y < x) {
+            x = y;
+            y = (x + n / x) / 2;
+        }
+        return x;
+    }
+
+    // pet level from its experience, floor(sqrt(experience / 100)) starting
+    // at level 1 and capped at the uint8_t range
+    constexpr uint8_t level_from_xp(const uint32_t experience) {
+        uint64_t level = isqrt(experience / 100);
+        return level == 0 ? 1 : level > UINT8_MAX ? UINT8_MAX : level;
+    }
+
+    static_assert(isqrt(0) == 0 && isqrt(1) == 1 && isqrt(3) == 1 && isqrt(4) == 2, "isqrt");
+    static_assert(isqrt(UINT64_MAX) == UINT32_MAX, "isqrt");
+    static_assert(level_from_xp(0) == 1 && level_from_xp(399) == 1 && level_from_xp(400) == 2, "level");
+    static_assert(level_from_xp(10000) == 10 && level_from_xp(UINT32_MAX) == UINT8_MAX, "level");
+}
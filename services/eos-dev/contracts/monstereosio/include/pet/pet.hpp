@@ -11,10 +11,10 @@
 #include <eosiolib/crypto.h>
 #include <eosiolib/transaction.hpp>
 #include <eosiolib/singleton.hpp>
-#include <math.h>
 #include <vector>
 #include <map>
 #include <pet/utils.hpp>
+#include <pet/random.hpp>
 #include <pet/types.hpp>
 
 using namespace eosio;
@@ -32,23 +32,25 @@ public:
     :eosio::contract(self),
     pettypes(_self,_self),
     elements(_self,_self),
+    attack_matrix(_self,_self),
     pets(_self,_self),
+    petstats(_self,_self),
     orders(_self,_self),
-    petinbattles(_self,_self),
     plsinbattles(_self,_self),
-    seed(_self, _self),
     accounts2(_self, _self),
+    accounts3(_self, _self),
     pet_config2(_self,_self)
     {}
 
     _tb_pet_types pettypes;
     _tb_elements  elements;
+    _tb_attack_matrix attack_matrix;
     _tb_pet pets;
+    _tb_pet_stats petstats;
     _tb_orders orders;
-    _tb_pet_in_battle petinbattles;
     _tb_player_in_battle plsinbattles;
-    _tb_seed seed;
     _tb_accounts2 accounts2;
+    _tb_accounts3 accounts3;
 
     // pet interactions
     void createpet    ( name owner, string pet_name );
@@ -58,6 +60,7 @@ public:
     void destroypet   ( uuid pet_id );
     void transferpet  ( uuid pet_id, name new_owner);
     void claimskill   ( uuid pet_id, uint8_t skill );
+    void petcarebatch ( name owner, vector<st_care_op> ops );
 
     // battle interface
     // void battlecreate ( name host, battle_mode mode, checksum256 secret );
@@ -68,7 +71,9 @@ public:
     void quickbattle  ( battle_mode mode, name player, st_pick picks );
     void battleattack ( name host, name player, uuid pet_id, uuid pet_enemy_id, element_type element );
     void battlefinish ( name host, name winner );
+    void battlejoined ( name host, name player );
     void battlepfdel  ( uuid pet_id, string reason );
+    void battlesweep  ( uint32_t started_at, name host, uint16_t limit );
 
     // market interface
     void orderask(uuid pet_id, name new_owner, asset amount, uint32_t until);
@@ -76,12 +81,16 @@ public:
     void claimpet(name old_owner, uuid pet_id, name claimer);
     void bidpet(uuid pet_id, name bidder, asset amount, uint32_t until);
     void removebid(name bidder, uuid pet_id);
+    void claimrefund(name owner);
+    void rentsweep(uint16_t limit);
+    void ordersweep(uint16_t limit);
 
     // admin/config interactions
     void addelemttype ( vector<uint8_t> ratios );
     void changeelemtt ( uint64_t id, vector<uint8_t> ratios );
     void addpettype   ( vector<uint8_t> elements );
     void changepettyp ( uint64_t id, vector<uint8_t> elements );
+    void buildatkmtx  ( uint64_t element_id );
     void changecrtol  ( uint32_t new_interval );
     void changebatma  ( uint16_t new_max_arenas );
     void changebatidt ( uint32_t new_idle_tolerance );
@@ -91,6 +100,10 @@ public:
     void changemktfee ( uint64_t new_fee, string reason );
     void changecreawk ( int64_t new_creation_awake, string reason );
     void changehungtz ( uint32_t new_hunger_to_zero, string reason );
+    void migrate      ( name table, uint16_t limit );
+    void setloottable ( uint64_t id, vector<st_loot_entry> entries );
+    void delloottable ( uint64_t id );
+    void delbattles   ( string reason );
 
     // token deposits
     void signup       ( name user );
@@ -98,10 +111,16 @@ public:
 
     // items
     void openchest    ( name player );
+    void openchests   ( name player, uint16_t count );
     void petconsume   ( uuid pet_id, symbol_type item );
     void issueitem    ( name player, asset item, string reason );
     void issueitems   ( name player, vector<asset> items, string reason );
     void chestreward  ( name owner, uint8_t modifier, string reason );
+    void chestrewards ( name player, uint16_t count, uint8_t modifier, string reason );
+    void itemsissued  ( name player, vector<asset> items, string reason );
+
+    // writes back the request scoped config, called by apply after dispatch
+    void flush_config();
 
     private:
 
@@ -126,7 +145,7 @@ public:
         uint8_t  attack_min_factor = 20;
         uint8_t  attack_max_factor = 28;
         uint16_t battle_max_arenas = 10;
-        uint16_t battle_busy_arenas = 0;
+        uint16_t battle_busy_arenas = 0; // legacy, arenas singleton seed
         uint16_t last_element_id = 0;
         uint16_t last_pet_type_id = 0;
     };
@@ -134,35 +153,90 @@ public:
     typedef singleton<N(petconfig2), st_pet_config2> pet_config2_singleton;
     pet_config2_singleton pet_config2;
 
+    // request scoped copy of petconfig2, read at most once per action
+    st_pet_config2 _pc;
+    bool _pc_loaded = false;
+    bool _pc_dirty = false;
+
     /* ****************************************** */
     /* ------------ Private Functions ----------- */
     /* ****************************************** */
 
     // internal config accessers
-    st_pet_config2 _get_pet_config();
+    const st_pet_config2& _get_pet_config();
     void _update_pet_config(const st_pet_config2 &pc);
     uuid _next_id();
     uint64_t _next_element_id();
     uint64_t _next_pet_type_id();
 
-    // generate pseudo random seeds
+    // attack matrix maintenance
+    void _set_attack_ratio(const st_elements &element, const st_pet_types &pet_type);
+    void _build_element_attack_ratios(const st_elements &element);
+    void _build_pet_type_attack_ratios(const st_pet_types &pet_type);
+
+    // transaction local pseudo random numbers
+    utils::entropy _entropy;
     int _random(const int num);
 
     // internal pet calcs
-    bool _is_alive(st_pets &pet, const st_pet_config2 &pc);
-    uint32_t _calc_hunger_hp(const uint8_t &max_hunger_points,
-                             const uint32_t &hunger_to_zero,
-                             const uint8_t &hunger_hp_modifier,
-                             const uint32_t &last_fed_at,
-                             const uint32_t &current_time);
+    st_pet_vitals _pet_vitals(const st_pet_counters &counters, const st_pet_config2 &pc);
+
+    // pet counters, pets without a petstats row read their legacy counters
+    // and get the row on their first write
+    st_pet_counters _pet_counters(const st_pets &pet);
+    _tb_pet_stats::const_iterator _get_pet_stats(const st_pets &pet);
+
+    // pet care, validates and applies a single care operation
+    void _feed_pet(_tb_pet::const_iterator itr_pet, const st_pet_config2 &pc);
+    void _bed_pet(_tb_pet::const_iterator itr_pet, const st_pet_config2 &pc);
+    void _awake_pet(_tb_pet::const_iterator itr_pet, const st_pet_config2 &pc);
+    void _consume_candies(name owner, uint32_t quantity);
+
+    // player accounts, moves accounts2 and v1 accounts3 items to the
+    // inventory table on first touch
+    _tb_accounts3::const_iterator _get_account(name owner, const char *error);
+    void _move_account2(_tb_accounts2::const_iterator itr_old_account);
+    uint64_t _item_balance(name owner, symbol_type item);
+    void _add_item(name owner, asset quantity);
+    void _add_items(name owner, const vector<asset> &items);
+
+    // paged migrations, each visits up to limit rows from the cursor and
+    // tells whether the table is done
+    bool _migrate_pets(st_migration &cursor, uint16_t limit);
+    bool _migrate_accounts2(st_migration &cursor, uint16_t limit);
+    bool _migrate_accounts3(st_migration &cursor, uint16_t limit);
+    bool _migrate_orders(st_migration &cursor, uint16_t limit);
+
+    // chests, schedules and rolls the rewards of many chests at once
+    void _schedule_chests(name player, uint16_t count, uint64_t chests_left);
+    vector<asset> _roll_chest_rewards(uint16_t count, uint8_t modifier);
+    void _sub_item(name owner, asset quantity, const char *error);
 
     // pet transfers
     void _transfer_value (name receiver, asset quantity, string memo);
-    void _handle_transf  (string memo, asset quantity, account_name from);
-    // void _transfer_pet   ( uuid pet_id, name new_owner);
+    void _handle_transf  (uuid orderid, const asset &quantity, account_name from);
+    void _handle_bid_transf(uuid orderid, const asset &quantity, account_name from);
+    void _transfer_pet   (uuid pet_id, name new_owner);
+    void _set_owner      (uuid pet_id, name new_owner);
+
+    // market matching, settles an ask against an escrowed bid
+    asset _market_fee(const asset &value, const st_pet_config2 &pc);
+    void _match_ask(uuid ask_id);
+    void _match_bid(uuid bid_id);
+    void _settle_orders(uuid ask_id, uuid bid_id);
+    asset _bid_escrow(uuid bid_id);
+    void _credit_refund(name owner, asset quantity);
+    void _refund_bid(const st_orders &bid);
 
 
     // battle helpers
     void _battle_add_pets(st_battle &battle, name player, vector<uint64_t> pet_ids, const st_pet_config2 &pc);
+    uint8_t _level_bracket(const vector<uint64_t> &pet_ids);
+    void _occupy_arena(const st_pet_config2 &pc);
+    void _release_arena();
+    void _battle_cancel(_tb_battle &tb_battles, _tb_battle::const_iterator itr_battle);
+    void _battle_finish(_tb_battle &tb_battles, _tb_battle::const_iterator itr_battle, name winner);
+    void _release_battle_pet(uuid pet_id);
+    bool _pet_in_battle(const st_pets &pet);
 
 };
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <eosiolib/action.h>
+#include <eosiolib/crypto.h>
+#include <eosiolib/system.h>
+#include <eosiolib/transaction.h>
+
+#include <cstring>
+#include <vector>
+
+namespace utils {
+
+    // Transaction local entropy source: the first draw hashes the packed
+    // transaction being executed, the current time and the data of the
+    // running action, so actions of one transaction draw different streams;
+    // later draws keep hashing the previous state. Nothing is read or
+    // written in tables, so actions don't contend on a shared seed row.
+    class entropy {
+    public:
+        uint64_t next() {
+            if (_used == WORDS) {
+                _refill();
+            }
+            return _words()[_used++];
+        }
+
+        uint64_t roll(const uint64_t num) {
+            return next() % num;
+        }
+
+    private:
+        static constexpr uint8_t WORDS = sizeof(checksum256) / sizeof(uint64_t);
+
+        checksum256 _state;
+        uint64_t    _counter = 0;
+        uint8_t     _used = WORDS;
+
+        const uint64_t* _words() const {
+            return reinterpret_cast<const uint64_t*>(&_state);
+        }
+
+        void _refill() {
+            if (_counter == 0) {
+                auto trx_size = transaction_size();
+                auto act_size = action_data_size();
+                std::vector<char> buffer(trx_size + sizeof(uint64_t) + act_size);
+                read_transaction(buffer.data(), trx_size);
+
+                uint64_t time = current_time();
+                memcpy(buffer.data() + trx_size, &time, sizeof(time));
+                read_action_data(buffer.data() + trx_size + sizeof(time), act_size);
+
+                sha256(buffer.data(), buffer.size(), &_state);
+            } else {
+                char buffer[sizeof(checksum256) + sizeof(uint64_t)];
+                memcpy(buffer, &_state, sizeof(checksum256));
+                memcpy(buffer + sizeof(checksum256), &_counter, sizeof(_counter));
+
+                sha256(buffer, sizeof(buffer), &_state);
+            }
+
+            _counter++;
+            _used = 0;
+        }
+    };
+}
@@ -2,10 +2,12 @@
 
 #include <string>
 #include <vector>
+#include <array>
 #include <boost/container/flat_map.hpp>
 #include <eosiolib/eosio.hpp>
 #include <eosiolib/asset.hpp>
-#include <math.h>
+#include <eosiolib/singleton.hpp>
+#include <pet/level.hpp>
 
 using std::vector;
 using std::map;
@@ -45,6 +47,37 @@ namespace types {
   const symbol_type SUPER_GOLD_XP_SCROLL = S(0,SGXSC);
   const symbol_type REVIVE_TOME = S(0,REVIV);
 
+  // inventory slots, the position of an item is its index on the v1
+  // accounts3 dense items
+  const symbol_type INVENTORY_ITEMS[] = {
+    CHEST, CANDY, ENERGY_DRINK,
+    SMALL_HP_POTION, MEDIUM_HP_POTION, LARGE_HP_POTION, TOTAL_HP_POTION,
+    INCREASED_ATTACK_ELIXIR, SUPER_ATTACK_ELIXIR,
+    INCREASED_DEFENSE_ELIXIR, SUPER_DEFENSE_ELIXIR,
+    INCREASED_HP_ELIXIR, SUPER_HP_ELIXIR,
+    BRONZE_XP_SCROLL, SILVER_XP_SCROLL, GOLD_XP_SCROLL,
+    SUPER_BRONZE_XP_SCROLL, SUPER_SILVER_XP_SCROLL, SUPER_GOLD_XP_SCROLL,
+    REVIVE_TOME
+  };
+  constexpr uint8_t INVENTORY_SLOTS = sizeof(INVENTORY_ITEMS) / sizeof(INVENTORY_ITEMS[0]);
+
+  // chests
+  constexpr uint8_t MAX_LOOT_ENTRIES = 64;
+  constexpr uint16_t MAX_CHESTS_OPEN = 200;
+
+  // accounts3 inventory format
+  constexpr uint8_t INVENTORY_V1 = 1;
+  constexpr uint8_t INVENTORY_V2 = 2; // items on the inventory table
+
+  // pet care batch operations
+  constexpr uint8_t PET_CARE_FEED = 1;
+  constexpr uint8_t PET_CARE_BED = 2;
+  constexpr uint8_t PET_CARE_AWAKE = 3;
+  constexpr uint8_t MAX_CARE_BATCH = 50;
+
+  // petstats flags, legacy pets rows kept them in field_a
+  constexpr uint8_t PET_FLAG_IN_BATTLE = 1;
+
   // players actions
   constexpr uint8_t OPEN_DAILY_CHEST = 1; 
   
@@ -52,12 +85,17 @@ namespace types {
   constexpr uint8_t MAX_DAILY_ENERGY_DRINKS = 10;
   constexpr uint8_t BATTLE_REQ_ENERGY = 8;
   constexpr uint8_t MAX_ENERGY_POINTS = 100;
+  constexpr uint8_t MAX_ELEMENTS = 32; // st_pet_stat elements bitmask size
 
   // battle modes
   constexpr battle_mode V1 = 1;
   constexpr battle_mode V2 = 2;
   constexpr battle_mode V3 = 3;
 
+  // battle capacity, arenas hold 2 players with up to V3 pets each
+  constexpr uint8_t BATTLE_MAX_PLAYERS = 2;
+  constexpr uint8_t BATTLE_MAX_PETS = BATTLE_MAX_PLAYERS * V3;
+
   // battle xp points
   constexpr uint16_t XP_WON = 799;
   constexpr uint16_t XP_LOST = 449;
@@ -66,21 +104,31 @@ namespace types {
   typedef uint8_t order_type;
   order_type ORDER_TYPE_ASK = 1;
   order_type ORDER_TYPE_BID = 2;
+  order_type ORDER_TYPE_BID_ESCROW = 3; // bid funded with an mtb transfer
   order_type ORDER_TYPE_ASK_RENT = 11;
   order_type ORDER_TYPE_BID_RENT = 12;
   order_type ORDER_TYPE_RENTING = 10;
 
   struct st_pet_stat {
-    uuid    pet_id;
-    uint8_t pet_type;
-    name    player;
-    uint8_t hp;
+    uuid     pet_id;
+    uint8_t  pet_type;
+    name     player;
+    uint8_t  hp;
+    uint32_t elements; // bitmask of the pet type elements
+
+    bool has_element(element_type const& element_id) const {
+      return element_id < MAX_ELEMENTS && (elements >> element_id) & 1;
+    }
   };
 
   struct st_commit {
-    name player;
-    checksum256 commitment;
-    vector<uint8_t> randoms{};
+    name    player;
+    uint8_t pets_alive = 0;
+  };
+
+  struct st_care_op {
+    uuid    pet_id;
+    uint8_t op;
   };
 
   struct st_pick {
@@ -99,7 +147,45 @@ namespace types {
   /* ------------ Contract Tables ------------- */
   /* ****************************************** */
 
+  // @abi table petstats i64
+  // hot pet counters, rewritten by care and battle actions instead of the
+  // whole pets row
+  struct st_pet_counters {
+      uuid     id;
+      uint32_t last_fed_at = 0;
+      uint32_t last_bed_at = 0;
+      uint32_t last_awake_at = 0;
+      uint32_t experience = 0;
+      uint8_t  energy_used = 0;
+      uint8_t  energy_drinks = 0;
+      uint8_t  flags = 0; // see PET_FLAG_*
+
+      uint64_t primary_key() const { return id; }
+
+      bool is_sleeping() const {
+          return last_bed_at > last_awake_at;
+      }
+
+      bool in_battle() const {
+          return flags & PET_FLAG_IN_BATTLE;
+      }
+
+      void set_in_battle(bool in_battle) {
+          flags = in_battle ? flags | PET_FLAG_IN_BATTLE : flags & ~PET_FLAG_IN_BATTLE;
+      }
+
+      uint8_t get_level() const {
+          return utils::level_from_xp(experience);
+      }
+
+      EOSLIB_SERIALIZE(st_pet_counters, (id)(last_fed_at)(last_bed_at)(last_awake_at)(experience)(energy_used)(energy_drinks)(flags))
+  };
+
+  typedef multi_index<N(petstats), st_pet_counters> _tb_pet_stats;
+
   // @abi table pets i64
+  // counters here are only written at creation, petstats has their
+  // current values
   struct st_pets {
       uuid id;
       name owner;
@@ -115,54 +201,48 @@ namespace types {
       uint32_t last_awake_at = 0;
       uint32_t experience = 0;
       uint8_t  energy_used = 0;
-      uint8_t  field_a = 0;
+      uint8_t  field_a = 0; // legacy flags, see PET_FLAG_*
       uint8_t  field_b = 0;
       uint8_t  field_c = 0;
 
       uint64_t primary_key() const { return id; }
 
       uint64_t get_pets_by_owner() const { return owner.value; }
+      uint128_t get_pets_by_owner_created() const { return utils::combine_ids(owner, created_at); }
 
-      bool is_sleeping() const {
-          return last_bed_at > last_awake_at;
+      // counters of pets created before petstats
+      st_pet_counters legacy_counters() const {
+          return st_pet_counters{id, last_fed_at, last_bed_at, last_awake_at,
+                                 experience, energy_used, energy_drinks, field_a};
       }
+  };
 
-      bool has_energy(const uint8_t min_energy) const {
-          uint32_t awake_seconds = now() - last_awake_at;
-          uint32_t energy_bar = MAX_ENERGY_POINTS - ((MAX_ENERGY_POINTS * awake_seconds) / DAY) - energy_used;
-
-          return energy_bar >= min_energy;
-      }
+  // pet state derived from its timestamps at one point in time, evaluated
+  // once per pet and action by pet::_pet_vitals
+  struct st_pet_vitals {
+      uint32_t at;
+      uint8_t  hp;
+      uint8_t  energy;
+      bool     sleeping;
 
-      uint8_t get_level() const {
-          auto level = floor(sqrt(0.01 * experience));
-          return level = 0 ? 1 : level;
-      }
+      bool is_alive() const { return hp > 0; }
+      bool has_energy(const uint8_t min_energy) const { return energy >= min_energy; }
   };
 
   typedef multi_index<N(pets), st_pets,
-      indexed_by<N(byowner), const_mem_fun<st_pets, uint64_t, &st_pets::get_pets_by_owner>>
+      indexed_by<N(byowner), const_mem_fun<st_pets, uint64_t, &st_pets::get_pets_by_owner>>,
+      indexed_by<N(byownercrt), const_mem_fun<st_pets, uint128_t, &st_pets::get_pets_by_owner_created>>
   > _tb_pet;
 
-  struct st_seed {
-    uint64_t pk = 1;
-    uint32_t last = 1;
-
-    uint64_t primary_key() const { return pk; }
-  };
-  typedef multi_index<N(seed), st_seed> _tb_seed;
-
-  // @abi table petinbattles i64
-  struct st_pet_inbatt {
-    uuid     pet_id;
-
-    uint64_t primary_key() const { return pet_id; }
-  };
-  typedef multi_index<N(petinbattles), st_pet_inbatt> _tb_pet_in_battle;
+  // pets secondary indexes position, as used by the raw index tables
+  constexpr uint64_t PETS_IDX_BYOWNERCRT = 1;
 
-  // @abi table petinbattles i64
+  // @abi table plsinbattles i64
+  // players in battle and the host of their battle, pets are flagged on
+  // their own rows
   struct st_pls_inbatt {
     name     player;
+    name     host;
 
     auto primary_key() const { return player; }
   };
@@ -223,6 +303,128 @@ namespace types {
   };
   typedef multi_index<N(accounts2), st_account2> _tb_accounts2;
 
+  struct st_item_balance {
+      symbol_type   symbol;
+      unsigned_int  amount;
+
+      EOSLIB_SERIALIZE(st_item_balance, (symbol)(amount))
+  };
+
+  // @abi table accounts3 i64
+  // v1 accounts counted items on the dense items, by inventory slot, and
+  // on the overflow; from v2 on items live on the inventory table and
+  // both are left empty. actions holds the last time of each player
+  // action, by action id - 1
+  struct st_account3 {
+      name                     owner;
+      uint8_t                  version = INVENTORY_V2;
+      vector<unsigned_int>     items;
+      vector<st_item_balance>  overflow;
+      vector<uint32_t>         actions;
+
+      uint64_t primary_key() const { return owner; }
+
+      // v1 item balances, to be moved to the inventory table
+      vector<asset> v1_items() const {
+        vector<asset> balances;
+        for (uint8_t i = 0; i < items.size() && i < INVENTORY_SLOTS; i++) {
+          if (items[i].value > 0)
+            balances.emplace_back(asset{items[i].value, INVENTORY_ITEMS[i]});
+        }
+        for (auto& item : overflow) {
+          if (item.amount.value > 0)
+            balances.emplace_back(asset{item.amount.value, item.symbol});
+        }
+        return balances;
+      }
+
+      uint32_t action_at(uint8_t action) const {
+        return action > 0 && action <= actions.size() ? actions[action - 1] : 0;
+      }
+
+      void set_action_at(uint8_t action, uint32_t at) {
+        if (action > actions.size()) actions.resize(action);
+        actions[action - 1] = at;
+      }
+
+      EOSLIB_SERIALIZE(st_account3, (owner)(version)(items)(overflow)(actions))
+  };
+  typedef multi_index<N(accounts3), st_account3> _tb_accounts3;
+
+  // @abi table inventory i64
+  // player items, scoped by player and one row per item symbol, so an item
+  // debit or credit only touches its own row
+  struct st_inventory_item {
+      asset    balance;
+
+      uint64_t primary_key() const { return balance.symbol.name(); }
+  };
+  typedef multi_index<N(inventory), st_inventory_item> _tb_inventory;
+
+  struct st_loot_entry {
+      symbol_type  symbol;
+      uint32_t     weight;
+      uint32_t     min_quantity; // a zero quantity entry drops nothing
+      uint32_t     max_quantity;
+
+      EOSLIB_SERIALIZE(st_loot_entry, (symbol)(weight)(min_quantity)(max_quantity))
+  };
+
+  // @abi table loottables i64
+  // chest loot slots, every chest draws one entry of each slot per reward
+  // modifier point. prob and alias are the Vose alias table of the entries
+  // weights, out of total_weight, so a draw costs the same for any size
+  struct st_loot_table {
+      uint64_t               id;
+      vector<st_loot_entry>  entries;
+      uint64_t               total_weight = 0;
+      vector<uint64_t>       prob;
+      vector<uint8_t>        alias;
+
+      uint64_t primary_key() const { return id; }
+
+      void build_alias() {
+        uint8_t n = entries.size();
+        vector<uint64_t> scaled(n);
+        vector<uint8_t> small, large;
+
+        total_weight = 0;
+        for (auto& entry : entries) {
+          total_weight += entry.weight;
+        }
+
+        for (uint8_t i = 0; i < n; i++) {
+          scaled[i] = uint64_t{entries[i].weight} * n;
+          if (scaled[i] < total_weight) small.push_back(i);
+          else large.push_back(i);
+        }
+
+        prob.assign(n, total_weight);
+        alias.resize(n);
+        for (uint8_t i = 0; i < n; i++) alias[i] = i;
+
+        while (!small.empty() && !large.empty()) {
+          auto s = small.back(); small.pop_back();
+          auto l = large.back(); large.pop_back();
+
+          prob[s] = scaled[s];
+          alias[s] = l;
+
+          scaled[l] = scaled[l] + scaled[s] - total_weight;
+          if (scaled[l] < total_weight) small.push_back(l);
+          else large.push_back(l);
+        }
+      }
+
+      // column from the low bits of a draw, coin from the high ones
+      const st_loot_entry& pick(uint64_t draw) const {
+        uint8_t column = (draw & 0xFFFFFFFF) % entries.size();
+        uint64_t coin = (draw >> 32) % total_weight;
+        return entries[coin < prob[column] ? column : alias[column]];
+      }
+  };
+  typedef multi_index<N(loottables), st_loot_table> _tb_loot_tables;
+
   // @abi table elements i64
   struct st_elements {
       uint64_t id;
@@ -241,74 +443,135 @@ namespace types {
   };
   typedef multi_index<N(pettypes), st_pet_types> _tb_pet_types;
 
+  // @abi table atkmatrix i64
+  // attack element ratio against a defender pet type, rebuilt whenever
+  // elements or pet types change
+  struct st_attack_ratio {
+      uint64_t id;
+      uint8_t  ratio;
+
+      uint64_t primary_key() const { return id; }
+
+      static uint64_t key(uint64_t element_id, uint64_t pet_type_id) {
+        return (element_id << 32) | pet_type_id;
+      }
+  };
+  typedef multi_index<N(atkmatrix), st_attack_ratio> _tb_attack_matrix;
+
   // @abi table battles i64
+  // fixed capacity arrays, only the first players_count commits and
+  // pets_count pets_stats are in use
   struct st_battle {
     name                host;
     battle_mode         mode; // 1: 1v1, 2: 2v2, 3: 3v3 :)
     uint32_t            started_at = 0;
     uint32_t            last_move_at = 0;
-    vector<st_commit>   commits{};
-    vector<st_pet_stat> pets_stats{};
+    uint8_t             players_count = 0;
+    uint8_t             pets_count = 0;
+    std::array<st_commit, BATTLE_MAX_PLAYERS> commits{};
+    std::array<st_pet_stat, BATTLE_MAX_PETS>  pets_stats{};
 
     auto primary_key() const { return host; }
     uint64_t by_started_at() const { return started_at; }
 
-    bool pet_exists(uuid& new_pet) {
-      for (const auto& stat : pets_stats) {
-        if(stat.pet_id == new_pet)
-          return true;
+    int8_t pet_index(uuid const& pet_id) const {
+      for (uint8_t i = 0; i < pets_count; i++) {
+        if (pets_stats[i].pet_id == pet_id)
+          return i;
       }
 
-      return false;
+      return -1;
+    }
+
+    bool pet_exists(uuid const& pet_id) const {
+      return pet_index(pet_id) >= 0;
     }
 
-    bool const player_exists(name const& player) {
-      for (const auto& commit : commits) {
-        if(commit.player == player)
-          return true;
+    int8_t player_index(name const& player) const {
+      for (uint8_t i = 0; i < players_count; i++) {
+        if (commits[i].player == player)
+          return i;
       }
 
-      return false;
+      return -1;
+    }
+
+    bool player_exists(name const& player) const {
+      return player_index(player) >= 0;
     }
 
     void remove_player(name const& player) {
       // remove player commitments
-      commits.erase(std::remove_if(commits.begin(), commits.end(),
-        [&](auto& commit) { return commit.player == player; }),
-        commits.end());
+      auto commits_end = std::remove_if(commits.begin(), commits.begin() + players_count,
+        [&](auto& commit) { return commit.player == player; });
+      players_count = commits_end - commits.begin();
+      std::fill(commits_end, commits.end(), st_commit{});
 
       // remove player pets
-      pets_stats.erase(std::remove_if(pets_stats.begin(), pets_stats.end(),
-        [&](auto& pet) { return pet.player == player; }),
-        pets_stats.end());
-    }
-
-    void add_player(name const& player, checksum256 const& commitment) {
-      st_commit commit{player, commitment};
-      commits.emplace_back(commit);
+      auto pets_end = std::remove_if(pets_stats.begin(), pets_stats.begin() + pets_count,
+        [&](auto& pet) { return pet.player == player; });
+      pets_count = pets_end - pets_stats.begin();
+      std::fill(pets_end, pets_stats.end(), st_pet_stat{});
     }
 
     void add_quick_player(name const& player) {
-      st_commit commit{player};
-      commits.emplace_back(commit);
+      eosio_assert(players_count < BATTLE_MAX_PLAYERS, "battle is already full of players");
+      commits[players_count++] = st_commit{player};
     }
 
-    void check_turn_and_rotate(name const& player, uint32_t const& tolerance) {
-      st_commit& commit = commits[0];
-
+    void check_turn(name const& player, uint32_t const& tolerance) const {
       bool is_idle = (now() - last_move_at) > tolerance;
 
-      eosio_assert(commit.player == player || is_idle, "its not your turn");
+      eosio_assert(commits[0].player == player || is_idle, "its not your turn");
+    }
 
+    void rotate_turn(name const& player) {
       // rotates only if it's the current player
-      if (player == commit.player) {
-        std::rotate(commits.begin(), commits.begin() + 1, commits.end());
+      if (player == commits[0].player) {
+        std::rotate(commits.begin(), commits.begin() + 1, commits.begin() + players_count);
+      }
+    }
+
+    void add_pet(uuid const& pet_id, st_pet_types const& pet_type, name const& player) {
+      auto player_idx = player_index(player);
+      eosio_assert(player_idx >= 0, "player not in this battle");
+      eosio_assert(pets_count < BATTLE_MAX_PETS, "battle is already full of pets");
+      eosio_assert(!pet_exists(pet_id), "pet already in battle");
+
+      uint32_t elements_mask{0};
+      for (const auto& element : pet_type.elements) {
+        if (element < MAX_ELEMENTS)
+          elements_mask |= uint32_t{1} << element;
+      }
+
+      pets_stats[pets_count++] = st_pet_stat{pet_id, uint8_t(pet_type.id), player, 100, elements_mask};
+      commits[player_idx].pets_alive++;
+    }
+
+    // damages a pet, keeping its player alive pets counter
+    void hit_pet(uint8_t const& pet_idx, uint8_t const& damage) {
+      auto& stat = pets_stats[pet_idx];
+      if (stat.hp == 0)
+        return;
+
+      stat.hp = damage > stat.hp ? 0 : stat.hp - damage;
+      if (stat.hp == 0) {
+        commits[player_index(stat.player)].pets_alive--;
       }
     }
 
-    void add_pet(uuid const& pet_id, uint8_t const& pet_type, name const& player) {
-      st_pet_stat pet_stat{pet_id, pet_type, player, 100};
-      pets_stats.emplace_back(pet_stat);
+    // the only player with alive pets, empty while the battle goes on
+    name winner() const {
+      uint8_t players_alive{0};
+      name last_alive{};
+      for (uint8_t i = 0; i < players_count; i++) {
+        if (commits[i].pets_alive > 0) {
+          players_alive++;
+          last_alive = commits[i].player;
+        }
+      }
+
+      return players_alive == 1 ? last_alive : name{};
     }
   };
 
@@ -316,6 +579,49 @@ namespace types {
   indexed_by< N(start), const_mem_fun<st_battle, uint64_t, &st_battle::by_started_at > >
   > _tb_battle;
 
+  // battles secondary indexes position, as used by the raw index tables
+  constexpr uint64_t BATTLES_IDX_START = 0;
+
+  // battle sweeper, lobbies and started battles idle for longer are
+  // cancelled or finished, at most MAX_BATTLE_SWEEP rows per run
+  constexpr uint32_t BATTLE_LOBBY_TTL = 30 * MINUTE;
+  constexpr uint32_t BATTLE_ABANDON_TTL = 30 * MINUTE;
+  constexpr uint32_t BATTLE_SWEEP_INTERVAL = 5 * MINUTE;
+  constexpr uint16_t MAX_BATTLE_SWEEP = 50;
+
+  // quickbattle pairs players whose strongest pets share a bracket
+  constexpr uint8_t LEVEL_BRACKET_SIZE = 10;
+
+  // @abi table mmqueue i64
+  // quickbattle lobbies waiting for an opponent, by host, popped in
+  // arrival order within the same mode and level bracket
+  struct st_queue_entry {
+    name        host;
+    battle_mode mode;
+    uint8_t     bracket;
+    uint32_t    enqueued_at;
+
+    uint64_t primary_key() const { return host; }
+    uint64_t by_mode_bracket() const { return key(mode, bracket, enqueued_at); }
+
+    static uint64_t key(battle_mode mode, uint8_t bracket, uint32_t enqueued_at) {
+      return (uint64_t{mode} << 40) | (uint64_t{bracket} << 32) | enqueued_at;
+    }
+  };
+
+  typedef multi_index<N(mmqueue), st_queue_entry,
+  indexed_by< N(bymodebrkt), const_mem_fun<st_queue_entry, uint64_t, &st_queue_entry::by_mode_bracket > >
+  > _tb_matchmaking;
+
+  constexpr uint64_t MMQUEUE_IDX_BYMODEBRKT = 0;
+
+  // @abi table arenas i64
+  // arenas occupied by battles, kept apart from the config singleton
+  struct st_arenas {
+    uint16_t busy = 0;
+  };
+  typedef singleton<N(arenas), st_arenas> _tb_arenas;
+
   // @abi table orders i64
   struct st_orders {
       uuid            id;
@@ -330,11 +636,88 @@ namespace types {
 
       uint64_t primary_key() const { return id; }
       uint128_t get_by_user_and_pet() const { return utils::combine_ids(user, pet_id); }
+      uint128_t get_by_pet_and_type() const { return utils::combine_ids(pet_id, type); }
+      uint128_t get_by_type_and_value() const { return utils::combine_ids(type, value.amount); }
+      uint128_t get_by_type_and_ends() const { return utils::combine_ids(type, transfer_ends_at); }
+      uint64_t get_by_ends_at() const { return ends_at; }
+
+      // orders without ends_at never expire: rentals in progress, and
+      // orders placed before expiry existed until migrate sets their TTL
+      bool is_expired(uint32_t at) const { return ends_at > 0 && ends_at <= at; }
 
       EOSLIB_SERIALIZE(st_orders, (id)(user)(type)(pet_id)(new_owner)(value)(placed_at)(ends_at)(transfer_ends_at))
   };
 
   typedef multi_index<N(orders), st_orders,
-      indexed_by<N(by_user_and_pet), const_mem_fun<st_orders, uint128_t, &st_orders::get_by_user_and_pet>>
+      indexed_by<N(by_user_and_pet), const_mem_fun<st_orders, uint128_t, &st_orders::get_by_user_and_pet>>,
+      indexed_by<N(bypettype), const_mem_fun<st_orders, uint128_t, &st_orders::get_by_pet_and_type>>,
+      indexed_by<N(bytypevalue), const_mem_fun<st_orders, uint128_t, &st_orders::get_by_type_and_value>>,
+      indexed_by<N(bytypeends), const_mem_fun<st_orders, uint128_t, &st_orders::get_by_type_and_ends>>,
+      indexed_by<N(byendsat), const_mem_fun<st_orders, uint64_t, &st_orders::get_by_ends_at>>
   > _tb_orders;
+
+  // @abi table bidescrows i64
+  // funds deposited for an escrowed bid, refunds and settlements pay back
+  // from it whatever the market fee is by then
+  struct st_bid_escrow {
+      uuid  order_id;
+      asset escrow;
+
+      uint64_t primary_key() const { return order_id; }
+
+      EOSLIB_SERIALIZE(st_bid_escrow, (order_id)(escrow))
+  };
+
+  typedef multi_index<N(bidescrows), st_bid_escrow> _tb_bid_escrows;
+
+  // @abi table refunds i64
+  // market funds owed to an account, sale proceeds and bid refunds are
+  // credited here and withdrawn with claimrefund
+  struct st_refund {
+      name  owner;
+      asset balance;
+
+      uint64_t primary_key() const { return owner; }
+
+      EOSLIB_SERIALIZE(st_refund, (owner)(balance))
+  };
+
+  typedef multi_index<N(refunds), st_refund> _tb_refunds;
+
+  // orders secondary indexes position, as used by the raw index tables.
+  // get_table_rows counts the primary key as index_position 1, so there
+  // by_user_and_pet is 2, bypettype 3, bytypevalue 4, bytypeends 5 and
+  // byendsat 6
+  constexpr uint64_t ORDERS_IDX_BYPETTYPE = 1;
+  constexpr uint64_t ORDERS_IDX_BYTYPEVALUE = 2;
+  constexpr uint64_t ORDERS_IDX_BYTYPEENDS = 3;
+  constexpr uint64_t ORDERS_IDX_BYENDSAT = 4;
+
+  // asks and bids are open for ORDER_TTL, then swept in batches
+  constexpr uint32_t ORDER_TTL = 30 * DAY;
+  constexpr uint32_t ORDER_SWEEP_INTERVAL = 1 * HOUR;
+  constexpr uint16_t MAX_ORDER_SWEEP = 50;
+
+  // rentals sweeper, expired rentals go back to their owners in batches
+  constexpr uint32_t RENT_SWEEP_INTERVAL = 10 * MINUTE;
+  constexpr uint16_t MAX_RENT_SWEEP = 50;
+
+  // @abi table migrations i64
+  // progress of a paged migration over a table, next is the primary key
+  // of the first row still to visit; erased when the migration finishes
+  struct st_migration {
+      name     table;
+      uint64_t next = 0;
+      uint64_t visited = 0;
+      uint64_t migrated = 0;
+      uint32_t started_at = 0;
+
+      uint64_t primary_key() const { return table; }
+
+      EOSLIB_SERIALIZE(st_migration, (table)(next)(visited)(migrated)(started_at))
+  };
+
+  typedef multi_index<N(migrations), st_migration> _tb_migrations;
+
+  constexpr uint16_t MAX_MIGRATE_ROWS = 200;
 }
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <eosiolib/crypto.h>
+#include <eosiolib/db.h>
 
 #include <string>
+#include <string_view>
 
 using std::string;
+using std::string_view;
 using namespace eosio;
 
 namespace utils {
@@ -32,5 +35,55 @@ namespace utils {
     uint128_t combine_ids(const uint64_t &x, const uint64_t &y) {
         return (uint128_t{x} << 64) | y;
     }
+
+    bool starts_with(string_view str, string_view prefix) {
+        return str.substr(0, prefix.size()) == prefix;
+    }
+
+    // strict decimal parsing, rejects empty input, signs, spaces, any
+    // trailing character and values over uint64
+    uint64_t parse_uint64(string_view str) {
+        eosio_assert(!str.empty() && str.size() <= 20, "invalid number");
+
+        uint64_t value = 0;
+        for (char c : str) {
+            eosio_assert(c >= '0' && c <= '9', "invalid number");
+            uint64_t digit = c - '0';
+            eosio_assert(value <= (UINT64_MAX - digit) / 10, "number overflow");
+            value = value * 10 + digit;
+        }
+        return value;
+    }
+
+    // raw table name of a multi_index secondary index, same rule as multi_index
+    uint64_t index_table(const uint64_t &table, const uint64_t &index_number) {
+        return (table & 0xFFFFFFFFFFFFFFF0ULL) | (index_number & 0x000000000000000FULL);
+    }
+
+    // rows emplaced before an index was declared have no entry on it, and
+    // multi_index fails to modify their keys; stores the missing entry
+    bool backfill_idx64(const uint64_t &code, const uint64_t &table, const uint64_t &index_number,
+                        const uint64_t &primary, const uint64_t &secondary) {
+        uint64_t idx_table = index_table(table, index_number);
+        uint64_t existent;
+        if (db_idx64_find_primary(code, code, idx_table, &existent, primary) >= 0) {
+            return false;
+        }
+
+        db_idx64_store(code, idx_table, code, primary, &secondary);
+        return true;
+    }
+
+    bool backfill_idx128(const uint64_t &code, const uint64_t &table, const uint64_t &index_number,
+                         const uint64_t &primary, const uint128_t &secondary) {
+        uint64_t idx_table = index_table(table, index_number);
+        uint128_t existent;
+        if (db_idx128_find_primary(code, code, idx_table, &existent, primary) >= 0) {
+            return false;
+        }
+
+        db_idx128_store(code, idx_table, code, primary, &secondary);
+        return true;
+    }
 }
 
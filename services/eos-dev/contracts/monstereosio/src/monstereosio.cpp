@@ -17,6 +17,7 @@
     if (valid_internal_actions || code == N(eosio.token) || action == N(onerror)) {                \
       TYPE thiscontract(self);                                                                     \
       switch (action) { EOSIO_API(TYPE, MEMBERS) }                                                 \
+      thiscontract.flush_config();                                                                 \
       /* does not allow destructor of thiscontract to run: eosio_exit(0); */                       \
     }                                                                                              \
   }                                                                                                \
@@ -30,6 +31,7 @@ EOSIO_ABI_EX(pet,
   (awakepet)
   (destroypet)
   (transferpet)
+  (petcarebatch)
 
   // battles
   // (battlecreate)
@@ -39,7 +41,9 @@ EOSIO_ABI_EX(pet,
   (battleleave)
   (battleattack)
   (battlefinish)
+  (battlejoined)
   (battlepfdel)
+  (battlesweep)
   (claimskill)
 
   // market
@@ -48,12 +52,16 @@ EOSIO_ABI_EX(pet,
   (claimpet)
   (bidpet)
   (removebid)
+  (claimrefund)
+  (rentsweep)
+  (ordersweep)
 
   // admins and config setup
   (addelemttype)
   (changeelemtt)
   (addpettype)
   (changepettyp)
+  (buildatkmtx)
   (changecrtol)
   (changebatma)
   (changebatidt)
@@ -63,11 +71,18 @@ EOSIO_ABI_EX(pet,
   (changemktfee)
   (changecreawk)
   (changehungtz)
+  (migrate)
+  (setloottable)
+  (delloottable)
+  (delbattles)
 
   // rewards
   (signup)
   (openchest)
+  (openchests)
   (chestreward)
+  (chestrewards)
+  (itemsissued)
   (issueitem)
   (issueitems)
   (petconsume)
@@ -1,18 +1,35 @@
 using namespace types;
+using namespace utils;
 
-// command to delete stuff
-// void pet::delbattles(string /* reason */) {
-//   require_auth(_self);
+// wipes battles, the in battle status tables and the legacy petinbattles
+// rows, needed whenever the battle layout changes as multi_index can't
+// erase rows of an old format; stale pets in battle flags are ignored
+void pet::delbattles(string /* reason */) {
+  require_auth(_self);
 
-//   // multi_index can't erase when the format changed
-//   auto it = db_lowerbound_i64(_self, _self, N(battles), 0);
-//   while (it >= 0) {
-//     auto     del = it;
-//     uint64_t dummy;
-//     it = db_next_i64(it, &dummy);
-//     db_remove_i64(del);
-//   }
-// }
+  for (auto table : {N(battles), N(petinbattles), N(plsinbattles), N(mmqueue)}) {
+    auto it = db_lowerbound_i64(_self, _self, table, 0);
+    while (it >= 0) {
+      auto     del = it;
+      uint64_t pk;
+      it = db_next_i64(it, &pk);
+      db_remove_i64(del);
+
+      // battles start and queue index entries go with the row
+      if (table == N(battles) || table == N(mmqueue)) {
+        uint64_t secondary;
+        auto idx_number = table == N(battles) ? BATTLES_IDX_START : MMQUEUE_IDX_BYMODEBRKT;
+        auto idx = db_idx64_find_primary(_self, _self, index_table(table, idx_number), &secondary, pk);
+        if (idx >= 0) {
+          db_idx64_remove(idx);
+        }
+      }
+    }
+  }
+
+  _tb_arenas arenas(_self, _self);
+  arenas.set(st_arenas{0}, _self);
+}
 
 void pet::changemktfee(uint64_t new_fee, string /* reason */) {
   require_auth(_self);
@@ -75,10 +92,13 @@ void pet::addelemttype(vector<uint8_t> ratios) {
 
   eosio_assert(ratios.size() > 0, "each type must have at least 1 ratio");
 
-  elements.emplace(_self, [&](auto& r) {
+  auto itr_elmt = elements.emplace(_self, [&](auto& r) {
     r.id     = _next_element_id();
     r.ratios = ratios;
   });
+  eosio_assert(itr_elmt->id < MAX_ELEMENTS, "elements limit reached");
+
+  _build_element_attack_ratios(*itr_elmt);
 }
 
 void pet::changeelemtt(uint64_t id, vector<uint8_t> ratios) {
@@ -88,9 +108,10 @@ void pet::changeelemtt(uint64_t id, vector<uint8_t> ratios) {
 
   auto itr_elmt = elements.find(id);
   eosio_assert(itr_elmt != elements.end(), "E404|Invalid element");
-  st_elements elmt = *itr_elmt;
 
   elements.modify(itr_elmt, _self, [&](auto& r) { r.ratios = ratios; });
+
+  _build_element_attack_ratios(*itr_elmt);
 }
 
 void pet::addpettype(vector<uint8_t> elements) {
@@ -98,10 +119,12 @@ void pet::addpettype(vector<uint8_t> elements) {
 
   eosio_assert(elements.size() > 0, "each type must have at least 1 element");
 
-  pettypes.emplace(_self, [&](auto& r) {
+  auto itr_pt = pettypes.emplace(_self, [&](auto& r) {
     r.id       = _next_pet_type_id();
     r.elements = elements;
   });
+
+  _build_pet_type_attack_ratios(*itr_pt);
 }
 
 void pet::changepettyp(uint64_t id, vector<uint8_t> elements) {
@@ -111,9 +134,188 @@ void pet::changepettyp(uint64_t id, vector<uint8_t> elements) {
 
   auto itr_pt = pettypes.find(id);
   eosio_assert(itr_pt != pettypes.end(), "E404|Invalid pet type");
-  st_pet_types pt = *itr_pt;
 
   pettypes.modify(itr_pt, _self, [&](auto& r) { r.elements = elements; });
+
+  _build_pet_type_attack_ratios(*itr_pt);
+}
+
+// fills the attack matrix of an element, for elements created before it existed
+void pet::buildatkmtx(uint64_t element_id) {
+  require_auth(_self);
+
+  const auto& element = elements.get(element_id, "E404|Invalid element");
+  _build_element_attack_ratios(element);
+}
+
+// converts the rows of a table to its current layout, limit rows per
+// call from the stored cursor; call it again until it prints that the
+// migration finished, it is safe to run over migrated rows:
+// - pets: byownercrt index entry and petstats row
+// - accounts2: moved to accounts3 and the inventory
+// - accounts3: v1 items moved to the inventory
+// - orders: bypettype, bytypevalue, bytypeends and byendsat index entries,
+//   ends_at of open orders placed before expiry existed
+void pet::migrate(name table, uint16_t limit) {
+  require_auth(_self);
+
+  eosio_assert(limit > 0 && limit <= MAX_MIGRATE_ROWS, "invalid migration limit");
+
+  _tb_migrations migrations(_self, _self);
+  auto itr_cursor = migrations.find(table);
+  st_migration cursor = itr_cursor != migrations.end()
+    ? *itr_cursor
+    : st_migration{table, 0, 0, 0, now()};
+
+  bool done = false;
+  switch (table) {
+    case N(pets):
+      done = _migrate_pets(cursor, limit);
+      break;
+    case N(accounts2):
+      done = _migrate_accounts2(cursor, limit);
+      break;
+    case N(accounts3):
+      done = _migrate_accounts3(cursor, limit);
+      break;
+    case N(orders):
+      done = _migrate_orders(cursor, limit);
+      break;
+    default:
+      eosio_assert(false, "E404|no migration for table");
+  }
+
+  print("\nvisited rows: ", cursor.visited, ", migrated rows: ", cursor.migrated);
+
+  if (done) {
+    if (itr_cursor != migrations.end()) migrations.erase(itr_cursor);
+    print("\nmigration finished");
+  } else {
+    if (itr_cursor != migrations.end()) {
+      migrations.modify(itr_cursor, 0, [&](auto &r) { r = cursor; });
+    } else {
+      migrations.emplace(_self, [&](auto &r) { r = cursor; });
+    }
+    print("\nnext row: ", cursor.next);
+  }
+}
+
+bool pet::_migrate_pets(st_migration &cursor, uint16_t limit) {
+  auto itr_pet = pets.lower_bound(cursor.next);
+  for (uint16_t i = 0; i < limit && itr_pet != pets.end(); i++, itr_pet++) {
+    bool by_owner_crt = backfill_idx128(_self, N(pets), PETS_IDX_BYOWNERCRT,
+                                        itr_pet->id, itr_pet->get_pets_by_owner_created());
+    bool stats = petstats.find(itr_pet->id) == petstats.end();
+    if (stats) {
+      _get_pet_stats(*itr_pet);
+    }
+
+    cursor.visited++;
+    if (by_owner_crt || stats) cursor.migrated++;
+  }
+
+  if (itr_pet == pets.end()) return true;
+  cursor.next = itr_pet->id;
+  return false;
+}
+
+// every visited row leaves accounts2, only rows without an accounts3 row
+// count as migrated
+bool pet::_migrate_accounts2(st_migration &cursor, uint16_t limit) {
+  auto itr_account = accounts2.lower_bound(cursor.next);
+  for (uint16_t i = 0; i < limit && itr_account != accounts2.end(); i++) {
+    auto itr_moving = itr_account++;
+    bool moved = accounts3.find(itr_moving->owner) == accounts3.end();
+    _move_account2(itr_moving);
+
+    cursor.visited++;
+    if (moved) cursor.migrated++;
+  }
+
+  if (itr_account == accounts2.end()) return true;
+  cursor.next = itr_account->owner;
+  return false;
+}
+
+bool pet::_migrate_accounts3(st_migration &cursor, uint16_t limit) {
+  auto itr_account = accounts3.lower_bound(cursor.next);
+  for (uint16_t i = 0; i < limit && itr_account != accounts3.end(); i++, itr_account++) {
+    if (itr_account->version == INVENTORY_V1) {
+      _get_account(itr_account->owner, "account is not signed up");
+      cursor.migrated++;
+    }
+    cursor.visited++;
+  }
+
+  if (itr_account == accounts3.end()) return true;
+  cursor.next = itr_account->owner;
+  return false;
+}
+
+bool pet::_migrate_orders(st_migration &cursor, uint16_t limit) {
+  auto itr_order = orders.lower_bound(cursor.next);
+  for (uint16_t i = 0; i < limit && itr_order != orders.end(); i++, itr_order++) {
+    bool by_pet = backfill_idx128(_self, N(orders), ORDERS_IDX_BYPETTYPE,
+                                  itr_order->id, itr_order->get_by_pet_and_type());
+    bool by_value = backfill_idx128(_self, N(orders), ORDERS_IDX_BYTYPEVALUE,
+                                    itr_order->id, itr_order->get_by_type_and_value());
+    bool by_ends = backfill_idx128(_self, N(orders), ORDERS_IDX_BYTYPEENDS,
+                                   itr_order->id, itr_order->get_by_type_and_ends());
+    bool by_ends_at = backfill_idx64(_self, N(orders), ORDERS_IDX_BYENDSAT,
+                                     itr_order->id, itr_order->get_by_ends_at());
+    // old orders get a full ORDER_TTL from the migration, not from placed_at
+    bool ttl = itr_order->ends_at == 0 && itr_order->type != ORDER_TYPE_RENTING;
+    if (ttl) {
+      orders.modify(itr_order, 0, [&](auto &r) {
+        r.ends_at = now() + ORDER_TTL;
+      });
+    }
+
+    cursor.visited++;
+    if (by_pet || by_value || by_ends || by_ends_at || ttl) cursor.migrated++;
+  }
+
+  if (itr_order == orders.end()) return true;
+  cursor.next = itr_order->id;
+  return false;
+}
+
+void pet::setloottable(uint64_t id, vector<st_loot_entry> entries) {
+  require_auth(_self);
+
+  eosio_assert(!entries.empty() && entries.size() <= MAX_LOOT_ENTRIES, "invalid number of loot entries");
+
+  uint64_t total_weight = 0;
+  for (auto& entry : entries) {
+    eosio_assert(entry.symbol.is_valid(), "invalid loot symbol");
+    eosio_assert(entry.weight > 0, "loot weight must be positive");
+    eosio_assert(entry.min_quantity <= entry.max_quantity, "invalid loot quantity range");
+    total_weight += entry.weight;
+  }
+  eosio_assert(total_weight <= UINT32_MAX, "loot weights are too big");
+
+  _tb_loot_tables loottables(_self, _self);
+  auto itr_table = loottables.find(id);
+
+  auto set_table = [&](auto &r) {
+    r.id = id;
+    r.entries = entries;
+    r.build_alias();
+  };
+
+  if (itr_table == loottables.end()) {
+    loottables.emplace(_self, set_table);
+  } else {
+    loottables.modify(itr_table, 0, set_table);
+  }
+}
+
+void pet::delloottable(uint64_t id) {
+  require_auth(_self);
+
+  _tb_loot_tables loottables(_self, _self);
+  const auto& table = loottables.get(id, "E404|Invalid loot table");
+  loottables.erase(table);
 }
 
 void pet::techrevive(uuid pet_id, string memo) {
@@ -121,11 +323,9 @@ void pet::techrevive(uuid pet_id, string memo) {
   print(pet_id, "| reviving pet for technical reasons... ");
   eosio_assert(memo.size() <= 256, "memo has more than 256 bytes");
 
-  auto itr_pet = pets.find(pet_id);
-  eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
-  st_pets pet = *itr_pet;
+  const auto& pet = pets.get(pet_id, "E404|Invalid pet");
 
-  pets.modify(itr_pet, 0, [&](auto& r) {
+  petstats.modify(_get_pet_stats(pet), 0, [&](auto& r) {
     // r.death_at      = 0;
     r.last_fed_at   = now();
     r.last_bed_at   = r.last_fed_at;
@@ -157,35 +357,66 @@ uint64_t pet::_next_pet_type_id() {
   return pc.last_pet_type_id - 1; // zero based id
 }
 
-pet::st_pet_config2 pet::_get_pet_config() {
-  st_pet_config2 pc;
+void pet::_set_attack_ratio(const st_elements& element, const st_pet_types& pet_type) {
+  // strongest ratio of the element against any of the pet type elements
+  uint8_t ratio{5}; // default ratio
+  for (const auto& pet_element : pet_type.elements) {
+    if (pet_element < element.ratios.size()) {
+      const auto& type_ratio = element.ratios[pet_element];
+      ratio = type_ratio > ratio ? type_ratio : ratio;
+    }
+  }
 
-  if (pet_config2.exists()) {
-    pc = pet_config2.get();
-  } else {
-    pc = st_pet_config2{};
+  auto key = st_attack_ratio::key(element.id, pet_type.id);
+  auto itr_ratio = attack_matrix.find(key);
+  if (itr_ratio == attack_matrix.end()) {
+    attack_matrix.emplace(_self, [&](auto& r) {
+      r.id    = key;
+      r.ratio = ratio;
+    });
+  } else if (itr_ratio->ratio != ratio) {
+    attack_matrix.modify(itr_ratio, 0, [&](auto& r) { r.ratio = ratio; });
+  }
+}
 
-    // // migration from old singleton
-    // if (pet_config.exists()) {
-    //   auto old_pc            = pet_config.get();
-    //   pc.last_id             = old_pc.last_id;
-    //   pc.creation_fee        = old_pc.creation_fee;
-    //   pc.max_health          = old_pc.max_health;
-    //   pc.hunger_to_zero      = old_pc.hunger_to_zero;
-    //   pc.min_hunger_interval = old_pc.min_hunger_interval;
-    //   pc.max_hunger_points   = old_pc.max_hunger_points;
-    //   pc.hunger_hp_modifier  = old_pc.hunger_hp_modifier;
-    //   pc.min_awake_interval  = old_pc.min_awake_interval;
-    //   pc.min_sleep_period    = old_pc.min_sleep_period;
-    //   pc.creation_tolerance  = old_pc.creation_tolerance;
+void pet::_build_element_attack_ratios(const st_elements& element) {
+  for (const auto& pet_type : pettypes) {
+    _set_attack_ratio(element, pet_type);
+  }
+}
 
-    //   pet_config.remove();
-    // }
+void pet::_build_pet_type_attack_ratios(const st_pet_types& pet_type) {
+  for (const auto& element : elements) {
+    _set_attack_ratio(element, pet_type);
+  }
+}
 
-    pet_config2.set(pc, _self);
+const pet::st_pet_config2& pet::_get_pet_config() {
+  if (_pc_loaded) {
+    return _pc;
   }
 
-  return pc;
+  if (pet_config2.exists()) {
+    _pc = pet_config2.get();
+  } else {
+    _pc = st_pet_config2{};
+
+    _pc_dirty = true;
+  }
+
+  _pc_loaded = true;
+  return _pc;
 }
 
-void pet::_update_pet_config(const st_pet_config2& pc) { pet_config2.set(pc, _self); }
+void pet::_update_pet_config(const st_pet_config2& pc) {
+  _pc        = pc;
+  _pc_loaded = true;
+  _pc_dirty  = true;
+}
+
+void pet::flush_config() {
+  if (_pc_dirty) {
+    pet_config2.set(_pc, _self);
+    _pc_dirty = false;
+  }
+}
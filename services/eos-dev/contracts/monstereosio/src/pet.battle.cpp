@@ -111,40 +111,45 @@ void pet::quickbattle(battle_mode mode, name player, st_pick picks) {
   eosio_assert(itr_player_battle == plsinbattles.end(), "player is already in another battle");
 
   _tb_battle tb_battles(_self, _self);
-  auto idx_battle = tb_battles.template get_index<N(start)>();
-  auto itr_battle = idx_battle.lower_bound( 0 );
+  _tb_matchmaking queue(_self, _self);
 
-  auto pc = _get_pet_config();
+  const auto& pc = _get_pet_config();
+  uint8_t bracket = _level_bracket(picks.pets);
 
-  // primer roller
-  _random(10);
+  // oldest lobby waiting in the same mode and bracket
+  auto idx_queue = queue.get_index<N(bymodebrkt)>();
+  auto itr_queue = idx_queue.lower_bound(st_queue_entry::key(mode, bracket, 0));
+  name host = player;
 
-  // no battle or only started battles, starting one
-  if (itr_battle == idx_battle.end() || itr_battle->started_at > 0) {
-    // check and increase busy arenas counter
-    pc.battle_busy_arenas++;
-    eosio_assert(pc.battle_busy_arenas <= pc.battle_max_arenas, "all arenas are busy");
+  if (itr_queue == idx_queue.end() || itr_queue->mode != mode || itr_queue->bracket != bracket) {
+    // no opponent waiting, opens a lobby
+    _occupy_arena(pc);
 
     st_battle battle{};
+    battle.host = player;
+    battle.mode = mode;
     battle.add_quick_player(player);
     _battle_add_pets(battle, player, picks.pets, pc);
 
     tb_battles.emplace(_self, [&](auto& r) {
+      r = battle;
+    });
+
+    queue.emplace(_self, [&](auto& r) {
       r.host = player;
       r.mode = mode;
-      r.commits = battle.commits;
-      r.pets_stats = battle.pets_stats;
+      r.bracket = bracket;
+      r.enqueued_at = now();
     });
-
-    _update_pet_config(pc);
   } else {
-    st_battle battle = *itr_battle;
-    battle.add_quick_player(player);
-    _battle_add_pets(battle, player, picks.pets, pc);
+    host = itr_queue->host;
+    auto itr_battle = tb_battles.find(host);
+    eosio_assert(itr_battle != tb_battles.end(), "battle not found for current host");
+    idx_queue.erase(itr_queue);
 
-    idx_battle.modify(itr_battle, 0, [&](auto& r) {
-      r.commits = battle.commits;
-      r.pets_stats = battle.pets_stats;
+    tb_battles.modify(itr_battle, 0, [&](auto& r) {
+      r.add_quick_player(player);
+      _battle_add_pets(r, player, picks.pets, pc);
       r.started_at = now();
       r.last_move_at = now();
     });
@@ -152,7 +157,46 @@ void pet::quickbattle(battle_mode mode, name player, st_pick picks) {
 
   plsinbattles.emplace(_self, [&](auto& r) {
     r.player = player;
+    r.host = host;
   });
+
+  // tells trackers which lobby the player joined
+  if (host != player) {
+    SEND_INLINE_ACTION(*this, battlejoined, {_self,N(active)}, {host, player});
+  }
+}
+
+void pet::battlejoined(name /* host */, name /* player */) {
+  require_auth(_self);
+
+  // no-op, quickbattle pairing log
+}
+
+uint8_t pet::_level_bracket(const vector<uint64_t> &pet_ids) {
+  uint8_t level = 1;
+  for (auto& pet_id : pet_ids) {
+    const auto& pet = pets.get(pet_id, "E404|Invalid pet");
+    level = std::max(level, _pet_counters(pet).get_level());
+  }
+  return level / LEVEL_BRACKET_SIZE;
+}
+
+// busy arenas counter starts from the legacy config counter
+void pet::_occupy_arena(const st_pet_config2 &pc) {
+  _tb_arenas arenas(_self, _self);
+  auto current = arenas.exists() ? arenas.get() : st_arenas{pc.battle_busy_arenas};
+
+  current.busy++;
+  eosio_assert(current.busy <= pc.battle_max_arenas, "all arenas are busy");
+  arenas.set(current, _self);
+}
+
+void pet::_release_arena() {
+  _tb_arenas arenas(_self, _self);
+  auto current = arenas.exists() ? arenas.get() : st_arenas{_get_pet_config().battle_busy_arenas};
+
+  if (current.busy > 0) current.busy--;
+  arenas.set(current, _self);
 }
 
 void pet::_battle_add_pets(st_battle &battle,
@@ -164,26 +208,25 @@ void pet::_battle_add_pets(st_battle &battle,
 
     auto itr_pet = pets.find(pet_id);
     eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
-    st_pets pet = *itr_pet;
+    const auto& pet = *itr_pet;
 
     // only owners can use their pets in battle
     require_auth(pet.owner);
-    eosio_assert(_is_alive(pet, pc), "dead pets don't battle");
-    eosio_assert(!pet.is_sleeping(), "sleeping pets don't battle");
-    eosio_assert(pet.has_energy(BATTLE_REQ_ENERGY), "pet has no energy for a battle");
-
-    // consume energy
-    pets.modify(itr_pet, 0, [&](auto& r) {
+    auto itr_stats = _get_pet_stats(pet);
+    auto vitals = _pet_vitals(*itr_stats, pc);
+    eosio_assert(vitals.is_alive(), "dead pets don't battle");
+    eosio_assert(!vitals.sleeping, "sleeping pets don't battle");
+    eosio_assert(vitals.has_energy(BATTLE_REQ_ENERGY), "pet has no energy for a battle");
+    eosio_assert(!_pet_in_battle(pet), "pet is already in another battle");
+
+    // consume energy and flag it in battle
+    petstats.modify(itr_stats, 0, [&](auto& r) {
       r.energy_used = r.energy_used + BATTLE_REQ_ENERGY;
+      r.set_in_battle(true);
     });
 
-    auto itr_pet_battle = petinbattles.find(pet_id);
-    eosio_assert(itr_pet_battle == petinbattles.end(), "pet is already in another battle");
-    petinbattles.emplace(_self, [&](auto& r) {
-      r.pet_id = pet_id;
-    });
-
-    battle.add_pet(pet_id, pet.type, player);
+    const auto& pet_type = pettypes.get(pet.type, "invalid pet type");
+    battle.add_pet(pet_id, pet_type, player);
   }
 }
 
@@ -194,24 +237,23 @@ void pet::battleleave(name host, name player) {
   _tb_battle tb_battles(_self, _self);
   auto itr_battle = tb_battles.find(host);
   eosio_assert(itr_battle != tb_battles.end(), "battle not found for current host");
-  st_battle battle = *itr_battle;
+  const auto& battle = *itr_battle;
 
   eosio_assert(battle.started_at == 0, "battle already started");
 
   eosio_assert(battle.player_exists(player), "player not in this battle");
 
-  // remove pets from battle
-  for (st_pet_stat ps : battle.pets_stats) {
-    auto itr_pet_battle = petinbattles.find(ps.pet_id);
-    if (itr_pet_battle != petinbattles.end()) {
-      petinbattles.erase( itr_pet_battle );
-    }
+  if (player == host) {
+    _battle_cancel(tb_battles, itr_battle);
+    return;
+  }
 
-    // undo used energy
-    auto itr_pet = pets.find(ps.pet_id);
-    pets.modify(itr_pet, 0, [&](auto& r) {
-      r.energy_used = r.energy_used - BATTLE_REQ_ENERGY;
-    });
+  // remove player pets from battle
+  for (uint8_t i = 0; i < battle.pets_count; i++) {
+    const auto& ps = battle.pets_stats[i];
+    if (ps.player != player) continue;
+
+    _release_battle_pet(ps.pet_id);
   }
 
   auto itr_player_battle = plsinbattles.find(player);
@@ -219,20 +261,59 @@ void pet::battleleave(name host, name player) {
     plsinbattles.erase( itr_player_battle );
   }
 
-  if (player == host) {
-    tb_battles.erase( itr_battle );
+  tb_battles.modify(itr_battle, 0, [&](auto& r) {
+    r.remove_player(player);
+  });
+}
 
-    // decrease busy arenas counter
-    auto pc = _get_pet_config();
-    pc.battle_busy_arenas--;
-    _update_pet_config(pc);
-  } else {
-    battle.remove_player(player);
-    tb_battles.modify(itr_battle, 0, [&](auto& r) {
-      r.commits = battle.commits;
-      r.pets_stats = battle.pets_stats;
-    });
+// drops a lobby, giving back the energy of its pets and its arena
+void pet::_battle_cancel(_tb_battle &tb_battles, _tb_battle::const_iterator itr_battle) {
+  const auto& battle = *itr_battle;
+
+  for (uint8_t i = 0; i < battle.pets_count; i++) {
+    const auto& ps = battle.pets_stats[i];
+    _release_battle_pet(ps.pet_id);
   }
+
+  for (uint8_t i = 0; i < battle.players_count; i++) {
+    auto itr_player_battle = plsinbattles.find(battle.commits[i].player);
+    if (itr_player_battle != plsinbattles.end()) {
+      plsinbattles.erase( itr_player_battle );
+    }
+  }
+
+  _tb_matchmaking queue(_self, _self);
+  auto itr_queue = queue.find(battle.host);
+  if (itr_queue != queue.end()) {
+    queue.erase( itr_queue );
+  }
+
+  tb_battles.erase( itr_battle );
+  _release_arena();
+}
+
+// takes a pet out of a lobby, giving back its battle energy
+void pet::_release_battle_pet(uuid pet_id) {
+  auto itr_pet = pets.find(pet_id);
+  if (itr_pet == pets.end()) return;
+
+  petstats.modify(_get_pet_stats(*itr_pet), 0, [&](auto& r) {
+    r.energy_used = r.energy_used > BATTLE_REQ_ENERGY ? r.energy_used - BATTLE_REQ_ENERGY : 0;
+    r.set_in_battle(false);
+  });
+}
+
+// the flag is left behind when battles are wiped by delbattles, so it
+// only counts while the owner battle still has the pet
+bool pet::_pet_in_battle(const st_pets &pet) {
+  if (!_pet_counters(pet).in_battle()) return false;
+
+  auto itr_player_battle = plsinbattles.find(pet.owner);
+  if (itr_player_battle == plsinbattles.end()) return false;
+
+  _tb_battle tb_battles(_self, _self);
+  auto itr_battle = tb_battles.find(itr_player_battle->host);
+  return itr_battle != tb_battles.end() && itr_battle->pet_exists(pet.id);
 }
 
 void pet::battleattack(name         host,
@@ -246,54 +327,32 @@ void pet::battleattack(name         host,
   _tb_battle tb_battles(_self, _self);
   auto itr_battle = tb_battles.find(host);
   eosio_assert(itr_battle != tb_battles.end(), "battle not found for current host");
-  st_battle battle = *itr_battle;
+  const auto& battle = *itr_battle;
 
-  auto pc = _get_pet_config();
+  const auto& pc = _get_pet_config();
 
-  // check and rotate turn only if player is not idle
-  battle.check_turn_and_rotate(player, pc.battle_idle_tolerance);
+  // check turn only if player is not idle
+  battle.check_turn(player, pc.battle_idle_tolerance);
 
   // get current pet and enemy types
-  uint8_t pet_type{0};
-  uint8_t pet_enemy_type_id{0};
-  bool valid_pet = false;
-  for (const auto& pet_stat : battle.pets_stats) {
-    if (pet_stat.pet_id == pet_id) {
-      eosio_assert(pet_stat.player == player, "you cannot control this monster");
-      eosio_assert(pet_stat.hp > 0, "this monster is dead");
-      pet_type = pet_stat.pet_type;
-      valid_pet = true;
-    } else if (pet_stat.pet_id == pet_enemy_id) {
-      pet_enemy_type_id = pet_stat.pet_type;
-    }
-  }
+  auto pet_idx = battle.pet_index(pet_id);
+  eosio_assert(pet_idx >= 0, "invalid attack");
+  const auto& pet_stat = battle.pets_stats[pet_idx];
+  eosio_assert(pet_stat.player == player, "you cannot control this monster");
+  eosio_assert(pet_stat.hp > 0, "this monster is dead");
 
-  eosio_assert(valid_pet, "invalid attack");
+  auto enemy_idx = battle.pet_index(pet_enemy_id);
+  eosio_assert(enemy_idx >= 0, "invalid enemy");
+  uint8_t pet_enemy_type_id = battle.pets_stats[enemy_idx].pet_type;
 
-  const auto& attack_pet_types = pettypes.get(pet_type, "invalid pet type");
-  bool valid_element = false;
-  for (const auto& pet_element : attack_pet_types.elements) {
-    if (pet_element == element_id) {
-      valid_element = true;
-      break;
-    }
-  }
-  eosio_assert(valid_element, "invalid attack element");
-
-  // cross ratio elements to enemy pet elements
-  uint8_t ratio{5}; // default ratio
-  const auto& attack_element = elements.get(element_id, "invalid element");
-  const auto& pet_enemy_types = pettypes.get(pet_enemy_type_id, "invalid pet enemy type");
-  for (const auto& pet_element : pet_enemy_types.elements) {
-    const auto& type_ratio = attack_element.ratios[pet_element];
-    ratio = type_ratio > ratio ? type_ratio : ratio;
-  }
+  eosio_assert(pet_stat.has_element(element_id), "invalid attack element");
+
+  // precomputed ratio of the element against enemy pet elements
+  const auto& attack_ratio = attack_matrix.get(
+    st_attack_ratio::key(element_id, pet_enemy_type_id), "invalid element");
+  uint8_t ratio = attack_ratio.ratio;
 
   // random factor to attack
-  // checksum256 result;
-  // sha256( (char *)&battle.commits[0], sizeof(battle.commits[1])*2, &result);
-  // uint8_t factor = (result.hash[1] + result.hash[0] + now()) %
-  //   (pc.attack_max_factor + 1 - pc.attack_min_factor) + pc.attack_min_factor;
   uint8_t factor = _random(pc.attack_max_factor + 1 - pc.attack_min_factor) + pc.attack_min_factor;
 
   // damage based on element ratio and factor
@@ -303,41 +362,19 @@ void pet::battleattack(name         host,
     "\nattack factor: ", int{factor});
 
   // updates pet hp and finish attack turn
-  std::map<name, uint8_t> alive_pets{};
-  for (auto& pet_stat : battle.pets_stats) {
-    if (pet_stat.pet_id == pet_enemy_id) {
-      pet_stat.hp = damage > pet_stat.hp ? 0 : pet_stat.hp - damage;
-    }
-
-    // update alive pets
-    uint8_t alive_counter = pet_stat.hp > 0 ? 1 : 0;
-    auto [it, success] = alive_pets.insert(
-      std::make_pair(pet_stat.player, alive_counter));
-    if (!success) {
-      it-> second = it->second + alive_counter;
-    }
+  tb_battles.modify(itr_battle, 0, [&](auto& r) {
+    r.hit_pet(enemy_idx, damage);
+    r.rotate_turn(player);
+    r.last_move_at = now();
+  });
 
-    print("\npet: ", pet_stat.pet_id, " - hp: ", int{pet_stat.hp});
+  for (uint8_t i = 0; i < battle.pets_count; i++) {
+    print("\npet: ", battle.pets_stats[i].pet_id, " - hp: ", int{battle.pets_stats[i].hp});
   }
 
   // check battle end
-  uint8_t players_alive{0};
-  name winner{};
-  for (auto const& [player, pets_alive] : alive_pets) {
-    if (pets_alive > 0) {
-      players_alive++;
-      winner = player;
-    }
-  }
-
-  // modify stats and goes to next turn or end battle
-  if (players_alive > 1) {
-    tb_battles.modify(itr_battle, 0, [&](auto& r) {
-      r.pets_stats = battle.pets_stats;
-      r.commits = battle.commits;
-      r.last_move_at = now();
-    });
-  } else {
+  name winner = battle.winner();
+  if (winner != name{}) {
     // we need an action here?
     print(" and the winner is >>> ", winner);
     SEND_INLINE_ACTION( *this, battlefinish, {_self,N(active)}, {host, winner} );
@@ -350,32 +387,34 @@ void pet::battlefinish(name host, name winner) {
   _tb_battle tb_battles(_self, _self);
   auto itr_battle = tb_battles.find(host);
   eosio_assert(itr_battle != tb_battles.end(), "battle not found for current host");
-  st_battle battle = *itr_battle;
 
-  // removes pets from in battle status table
-  for (st_pet_stat &ps : battle.pets_stats) {
-    auto itr_pet_battle = petinbattles.find(ps.pet_id);
-    if (itr_pet_battle != petinbattles.end()) {
-      petinbattles.erase( itr_pet_battle );
-    }
+  _battle_finish(tb_battles, itr_battle, winner);
+}
 
-    // add experience points
+void pet::_battle_finish(_tb_battle &tb_battles, _tb_battle::const_iterator itr_battle, name winner) {
+  const auto& battle = *itr_battle;
+
+  // add experience points and clear pets in battle flag
+  for (uint8_t i = 0; i < battle.pets_count; i++) {
+    const auto& ps = battle.pets_stats[i];
     auto itr_pet = pets.find(ps.pet_id);
     if (itr_pet != pets.end()) {
-      pets.modify(itr_pet, 0, [&](auto& r) {
+      const auto& pet = *itr_pet;
+      petstats.modify(_get_pet_stats(pet), 0, [&](auto& r) {
+        r.set_in_battle(false);
         
         // adjust legacy pets
         if (r.experience > 1500000000) 
           r.experience = 0;
         
-        r.experience = r.experience + (winner == r.owner ? XP_WON : XP_LOST);
+        r.experience = r.experience + (winner == pet.owner ? XP_WON : XP_LOST);
       });
     }
   }
 
   // removes players from in battle status table
-  for (st_commit &cmm : battle.commits) {
-    auto itr_player_battle = plsinbattles.find(cmm.player);
+  for (uint8_t i = 0; i < battle.players_count; i++) {
+    auto itr_player_battle = plsinbattles.find(battle.commits[i].player);
     if (itr_player_battle != plsinbattles.end()) {
       plsinbattles.erase( itr_player_battle );
     }
@@ -383,19 +422,82 @@ void pet::battlefinish(name host, name winner) {
 
   tb_battles.erase( itr_battle );
 
-  // decrease busy arenas counter
-  auto pc = _get_pet_config();
-  pc.battle_busy_arenas--;
-  _update_pet_config(pc);
+  _release_arena();
+}
+
+// walks the battles start index from (started_at, host) cancelling idle
+// lobbies and finishing abandoned battles, the player waiting on the idle
+// one wins; reschedules itself from where it stopped
+void pet::battlesweep(uint32_t started_at, name host, uint16_t limit) {
+  require_auth(_self);
 
-  // primer roller
-  _random(10);
+  eosio_assert(limit > 0 && limit <= MAX_BATTLE_SWEEP, "invalid sweep limit");
 
+  _tb_battle tb_battles(_self, _self);
+  _tb_matchmaking queue(_self, _self);
+  auto idx_battle = tb_battles.get_index<N(start)>();
+  auto itr_battle = idx_battle.lower_bound(started_at);
+
+  vector<name> cancelled{};
+  vector<std::pair<name, name>> finished{};
+  uint32_t current_time = now();
+
+  uint16_t visited = 0;
+  for (; itr_battle != idx_battle.end() && visited < limit; itr_battle++) {
+    // same start time battles are ordered by host
+    if (itr_battle->started_at == started_at && itr_battle->host.value < host.value) continue;
+    visited++;
+
+    if (itr_battle->started_at == 0) {
+      auto itr_queue = queue.find(itr_battle->host);
+      if (itr_queue == queue.end() || current_time - itr_queue->enqueued_at > BATTLE_LOBBY_TTL) {
+        cancelled.emplace_back(itr_battle->host);
+      }
+    } else if (current_time - itr_battle->last_move_at > BATTLE_ABANDON_TTL) {
+      // commits[0] is the player on turn
+      name winner = itr_battle->players_count > 1 ? itr_battle->commits[1].player : name{};
+      finished.emplace_back(itr_battle->host, winner);
+    }
+  }
+
+  // next run starts from the first battle not visited
+  uint32_t next_started_at = 0;
+  name next_host{};
+  uint32_t delay = BATTLE_SWEEP_INTERVAL;
+  if (itr_battle != idx_battle.end()) {
+    next_started_at = itr_battle->started_at;
+    next_host = itr_battle->host;
+    delay = 1;
+  }
+
+  for (auto& lobby_host : cancelled) {
+    _battle_cancel(tb_battles, tb_battles.find(lobby_host));
+  }
+  // finished through battlefinish so trackers see them like attack wins
+  for (auto& battle : finished) {
+    SEND_INLINE_ACTION(*this, battlefinish, {_self,N(active)}, {battle.first, battle.second});
+  }
+
+  print("\ncancelled lobbies: ", cancelled.size(), "\nfinished battles: ", finished.size());
+
+  transaction trx{};
+  trx.actions.emplace_back(
+      permission_level{_self, N(active)},
+      _self, N(battlesweep),
+      std::make_tuple(next_started_at, next_host, limit)
+  );
+  trx.delay_sec = delay;
+  trx.send(N(battlesweep), _self, true);
 }
 
-// force removes a pet from petinbattles table
+// force clears a pet in battle flag
 void pet::battlepfdel( uuid pet_id, string /* reason */ ) {
-  auto itr_pet_battle = petinbattles.find(pet_id);
-  eosio_assert(itr_pet_battle != petinbattles.end(), "Invalid pet battle stat");
-  petinbattles.erase( itr_pet_battle );
+  require_auth(_self);
+
+  const auto& pet = pets.get(pet_id, "Invalid pet battle stat");
+  auto itr_stats = _get_pet_stats(pet);
+  eosio_assert(itr_stats->in_battle(), "Invalid pet battle stat");
+  petstats.modify(itr_stats, 0, [&](auto& r) {
+    r.set_in_battle(false);
+  });
 }
\ No newline at end of file
@@ -25,21 +25,22 @@ void pet::createpet(name owner,
     // eosio_assert(!_pet_name_exists(pet_name), "duplicated pet name");
 
     // initialize config
-    auto pc = _get_pet_config();
+    const auto& pc = _get_pet_config();
 
     // check last pet creation tolerance
     if (pc.creation_tolerance > 0) {
 
-        auto owner_pets = pets.get_index<N(byowner)>();
-        auto last_pet_itr = owner_pets.find(owner);
+        // newest pet of the owner is the last entry of its index range
+        auto idx_owner_created = pets.get_index<N(byownercrt)>();
+        auto itr_last_pet = idx_owner_created.upper_bound(combine_ids(owner, UINT64_MAX));
 
         uint32_t last_created_date = 0;
 
-        for (; last_pet_itr != owner_pets.end(); last_pet_itr++) {
-            auto pet = *last_pet_itr;
-            if (pet.owner != owner) break;
-            last_created_date = pet.created_at > last_created_date ?
-                pet.created_at : last_created_date;
+        if (itr_last_pet != idx_owner_created.begin()) {
+            itr_last_pet--;
+            if (itr_last_pet->owner == owner) {
+                last_created_date = itr_last_pet->created_at;
+            }
         }
 
         if (last_created_date > 0) {
@@ -71,6 +72,10 @@ void pet::createpet(name owner,
 
         r = pet;
     });
+
+    petstats.emplace(owner, [&](auto &r) {
+        r = pets.get(new_id).legacy_counters();
+    });
 }
 
 void pet::destroypet(uuid pet_id) {
@@ -79,117 +84,271 @@ void pet::destroypet(uuid pet_id) {
 
     require_auth(pet.owner);
 
-    uint8_t level = pet.get_level();
+    uint8_t level = _pet_counters(pet).get_level();
     string msg = "pet level is 231"; // + boost::lexical_cast<string, uint8_t>(level);
     print(msg);
 
     // pets.erase( pet );
-
-    // primer roller
-    _random(10);
 }
 
 void pet::transferpet(uuid pet_id, name new_owner) {
 
-    auto itr_pet = pets.find(pet_id);
-    eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
-    auto pet = *itr_pet;
+    const auto& pet = pets.get(pet_id, "E404|Invalid pet");
 
     eosio_assert(has_auth(_self) || has_auth(pet.owner),
         "missing required authority of contract or owner");
 
-    // require_auth(pet.owner);
+    _transfer_pet(pet_id, new_owner);
+}
+
+// changes the owner and notifies them, used by the actions the new owner
+// asked for (claimpet, transferpet)
+void pet::_transfer_pet(uuid pet_id, name new_owner) {
+
+    _set_owner(pet_id, new_owner);
+    require_recipient(new_owner);
+}
+
+// changes the owner in place without notifying anyone, settlements run
+// inside other accounts' actions and must not depend on the new owner
+// accepting a notification
+void pet::_set_owner(uuid pet_id, name new_owner) {
+
+    auto itr_pet = pets.find(pet_id);
+    eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
+    eosio_assert(!_pet_in_battle(*itr_pet), "pet is in battle");
 
     pets.modify(itr_pet, 0, [&](auto &r) {
         r.owner = new_owner;
     });
 
-    // primer roller
-    _random(10);
+    print(pet_id, "| pet transferred to ", new_owner);
 }
 
 void pet::feedpet(uuid pet_id) {
 
     auto itr_pet = pets.find(pet_id);
     eosio_assert(itr_pet != pets.end(), "Invalid pet");
-    st_pets pet = *itr_pet;
-
-    require_auth(pet.owner);
 
-    auto pc = _get_pet_config();
+    require_auth(itr_pet->owner);
 
-    eosio_assert(_is_alive(pet, pc), "dead don't eat");
-    eosio_assert(!pet.is_sleeping(), "zzzzzz");
-
-    bool can_eat = (now() - pet.last_fed_at) > pc.min_hunger_interval;
-    eosio_assert(can_eat, "not hungry");
+    _feed_pet(itr_pet, _get_pet_config());
 
     // check and consume candy
-    auto itr_account = accounts2.find(pet.owner);
-    eosio_assert(itr_account != accounts2.end(), "pet owner is not signed up");
-    st_account2 account = *itr_account;
-    auto player_candies = account.assets[CANDY];
-    eosio_assert(player_candies >= 1, "player has no candy to feed");
-    accounts2.modify(itr_account, 0, [&](auto &r) {
-        r.assets[CANDY] = player_candies - 1;
-    });
-
-    pets.modify(itr_pet, pet.owner, [&](auto &r) {
-        r.last_fed_at = now();
-    });
-
-    // primer roller
-    _random(10);
+    _consume_candies(itr_pet->owner, 1);
 }
 
 void pet::bedpet(uuid pet_id) {
     auto itr_pet = pets.find(pet_id);
     eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
-    st_pets pet = *itr_pet;
 
     // only owners can make pets sleep
-    require_auth(pet.owner);
-
-    auto pc = _get_pet_config();
+    require_auth(itr_pet->owner);
 
-    eosio_assert(_is_alive(pet, pc), "dead don't sleep");
-    eosio_assert(!pet.is_sleeping(), "already sleeping");
-
-    bool can_sleep = (now() - pet.last_awake_at) > pc.min_awake_interval;
-    eosio_assert(can_sleep, "not now!");
-
-    pets.modify(itr_pet, pet.owner, [&](auto &r) {
-        r.last_bed_at = now();
-    });
-
-    // primer roller
-    _random(10);
+    _bed_pet(itr_pet, _get_pet_config());
 }
 
 void pet::awakepet(uuid pet_id) {
     auto itr_pet = pets.find(pet_id);
     eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
-    st_pets pet = *itr_pet;
 
     // only owners can wake up pets
-    require_auth(pet.owner);
+    require_auth(itr_pet->owner);
+
+    _awake_pet(itr_pet, _get_pet_config());
+}
+
+void pet::petcarebatch(name owner, vector<st_care_op> ops) {
+
+    require_auth(owner);
+
+    eosio_assert(ops.size() > 0, "no pet care operations");
+    eosio_assert(ops.size() <= MAX_CARE_BATCH, "too many pet care operations");
+
+    const auto& pc = _get_pet_config();
+
+    uint32_t candies = 0;
+    for (const auto& op : ops) {
+        auto itr_pet = pets.find(op.pet_id);
+        eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
+        eosio_assert(itr_pet->owner == owner, "pet does not belong to owner");
+
+        switch (op.op) {
+            case PET_CARE_FEED:
+                _feed_pet(itr_pet, pc);
+                candies++;
+                break;
+            case PET_CARE_BED:
+                _bed_pet(itr_pet, pc);
+                break;
+            case PET_CARE_AWAKE:
+                _awake_pet(itr_pet, pc);
+                break;
+            default:
+                eosio_assert(false, "invalid pet care operation");
+        }
+    }
+
+    if (candies > 0) {
+        _consume_candies(owner, candies);
+    }
+}
+
+void pet::_feed_pet(_tb_pet::const_iterator itr_pet, const st_pet_config2 &pc) {
+    auto itr_stats = _get_pet_stats(*itr_pet);
+    auto vitals = _pet_vitals(*itr_stats, pc);
+
+    eosio_assert(vitals.is_alive(), "dead don't eat");
+    eosio_assert(!vitals.sleeping, "zzzzzz");
+
+    bool can_eat = (vitals.at - itr_stats->last_fed_at) > pc.min_hunger_interval;
+    eosio_assert(can_eat, "not hungry");
+
+    petstats.modify(itr_stats, 0, [&](auto &r) {
+        r.last_fed_at = vitals.at;
+    });
+}
 
-    auto pc = _get_pet_config();
+void pet::_bed_pet(_tb_pet::const_iterator itr_pet, const st_pet_config2 &pc) {
+    auto itr_stats = _get_pet_stats(*itr_pet);
+    auto vitals = _pet_vitals(*itr_stats, pc);
 
-    eosio_assert(_is_alive(pet, pc), "dead don't awake");
-    eosio_assert(pet.is_sleeping(), "already awake");
+    eosio_assert(vitals.is_alive(), "dead don't sleep");
+    eosio_assert(!vitals.sleeping, "already sleeping");
 
-    bool can_awake = (now() - pet.last_bed_at) > pc.min_sleep_period;
+    bool can_sleep = (vitals.at - itr_stats->last_awake_at) > pc.min_awake_interval;
+    eosio_assert(can_sleep, "not now!");
+
+    petstats.modify(itr_stats, 0, [&](auto &r) {
+        r.last_bed_at = vitals.at;
+    });
+}
+
+void pet::_awake_pet(_tb_pet::const_iterator itr_pet, const st_pet_config2 &pc) {
+    auto itr_stats = _get_pet_stats(*itr_pet);
+    auto vitals = _pet_vitals(*itr_stats, pc);
+
+    eosio_assert(vitals.is_alive(), "dead don't awake");
+    eosio_assert(vitals.sleeping, "already awake");
+
+    bool can_awake = (vitals.at - itr_stats->last_bed_at) > pc.min_sleep_period;
     eosio_assert(can_awake, "zzzzzz");
 
-    pets.modify(itr_pet, pet.owner, [&](auto &r) {
-        r.last_awake_at = now();
+    petstats.modify(itr_stats, 0, [&](auto &r) {
+        r.last_awake_at = vitals.at;
         r.energy_drinks = 0;
         r.energy_used = 0;
     });
+}
+
+void pet::_consume_candies(name owner, uint32_t quantity) {
+    _sub_item(owner, asset{quantity, CANDY}, "player has no candy to feed");
+}
+
+_tb_accounts3::const_iterator pet::_get_account(name owner, const char *error) {
+    _tb_inventory inventory(_self, owner);
+
+    auto itr_account = accounts3.find(owner);
+    if (itr_account != accounts3.end()) {
+        if (itr_account->version == INVENTORY_V1) {
+            for (auto& item : itr_account->v1_items()) {
+                inventory.emplace(_self, [&](auto &r) { r.balance = item; });
+            }
+            accounts3.modify(itr_account, 0, [&](auto &r) {
+                r.version = INVENTORY_V2;
+                r.items.clear();
+                r.overflow.clear();
+            });
+        }
+        return itr_account;
+    }
+
+    auto itr_old_account = accounts2.find(owner);
+    eosio_assert(itr_old_account != accounts2.end(), error);
+
+    _move_account2(itr_old_account);
+    return accounts3.find(owner);
+}
+
+// moves an accounts2 row to accounts3 and the inventory, a player that
+// already has an accounts3 row only gets the balances merged
+void pet::_move_account2(_tb_accounts2::const_iterator itr_old_account) {
+    name owner = itr_old_account->owner;
+    _tb_inventory inventory(_self, owner);
+
+    auto itr_account = accounts3.find(owner);
+    if (itr_account == accounts3.end()) {
+        accounts3.emplace(_self, [&](auto &r) {
+            r.owner = owner;
+            for (auto& action : itr_old_account->actions) {
+                if (action.first > 0) r.set_action_at(action.first, action.second);
+            }
+        });
+    } else {
+        _get_account(owner, "account is not signed up");
+    }
+
+    for (auto& item : itr_old_account->assets) {
+        if (item.second == 0) continue;
+
+        asset quantity{item.second, item.first};
+        auto itr_item = inventory.find(quantity.symbol.name());
+        if (itr_item == inventory.end()) {
+            inventory.emplace(_self, [&](auto &r) { r.balance = quantity; });
+        } else {
+            inventory.modify(itr_item, 0, [&](auto &r) { r.balance += quantity; });
+        }
+    }
+    accounts2.erase(itr_old_account);
+}
 
-    // primer roller
-    _random(10);
+uint64_t pet::_item_balance(name owner, symbol_type item) {
+    _tb_inventory inventory(_self, owner);
+    auto itr_item = inventory.find(item.name());
+    return itr_item == inventory.end() ? 0 : itr_item->balance.amount;
+}
+
+void pet::_add_item(name owner, asset quantity) {
+    _add_items(owner, {quantity});
+}
+
+void pet::_add_items(name owner, const vector<asset> &items) {
+    _get_account(owner, "account is not signed up");
+
+    // rows are opened on the first credit and erased once spent, credits
+    // come from the contract so it pays for them
+    _tb_inventory inventory(_self, owner);
+    for (auto& quantity : items) {
+        eosio_assert(quantity.is_valid(), "Invalid item issue");
+        eosio_assert(quantity.amount > 0, "Quantity must be positive");
+
+        auto itr_item = inventory.find(quantity.symbol.name());
+        if (itr_item == inventory.end()) {
+            inventory.emplace(_self, [&](auto &r) { r.balance = quantity; });
+        } else {
+            inventory.modify(itr_item, 0, [&](auto &r) { r.balance += quantity; });
+        }
+    }
+}
+
+void pet::_sub_item(name owner, asset quantity, const char *error) {
+    _tb_inventory inventory(_self, owner);
+    auto itr_item = inventory.find(quantity.symbol.name());
+
+    // items may still be on an old account layout
+    if (itr_item == inventory.end()) {
+        _get_account(owner, "account is not signed up");
+        itr_item = inventory.find(quantity.symbol.name());
+    }
+
+    eosio_assert(itr_item != inventory.end() && itr_item->balance >= quantity, error);
+
+    // only items the player holds keep a row
+    if (itr_item->balance == quantity) {
+        inventory.erase(itr_item);
+    } else {
+        inventory.modify(itr_item, 0, [&](auto &r) { r.balance -= quantity; });
+    }
 }
 
 void pet::claimskill(uuid pet_id, uint8_t skill) {
@@ -200,7 +359,7 @@ void pet::claimskill(uuid pet_id, uint8_t skill) {
     // only owners can claim skill
     require_auth(pet.owner);
 
-    uint8_t level = pet.get_level();
+    uint8_t level = _pet_counters(pet).get_level();
     
     bool novice_skill = skill < 10 && level >= 10 && pet.skill1 == 0;
     bool medium_skill = skill >= 10 && skill < 20 && level >= 50 && pet.skill2 == 0;
@@ -217,17 +376,14 @@ void pet::claimskill(uuid pet_id, uint8_t skill) {
             r.skill3 = skill;
         }
     });
-
-    // primer roller
-    _random(10);
 }
 
 void pet::signup(name user) {
 
     require_auth(user);
     
-    auto itr_account = accounts2.find(user);
-    eosio_assert(itr_account == accounts2.end(), "you have signed up already");
+    eosio_assert(accounts3.find(user) == accounts3.end() &&
+        accounts2.find(user) == accounts2.end(), "you have signed up already");
 
     // check user was an early donator :)
     _tb_accounts accounts(_self, user);
@@ -243,16 +399,10 @@ void pet::signup(name user) {
     //     accounts.erase(itr_balance);
     //     // donator_reward(user); TODO: implement here
     // } else {
-        accounts2.emplace(user, [&](auto& r){
-            // r.assets.emplace(new_balance.symbol, new_balance.amount);
-            r.initialize_actions();
-            r.initialize_assets();
+        accounts3.emplace(user, [&](auto& r){
             r.owner = user;
         });
     // }
-
-    // primer roller
-    _random(10);
 }
 
 void pet::transfer(uint64_t sender, uint64_t receiver) {
@@ -274,13 +424,17 @@ void pet::transfer(uint64_t sender, uint64_t receiver) {
     eosio_assert(transfer_data.quantity.is_valid(), "Invalid token transfer");
     eosio_assert(transfer_data.quantity.amount > 0, "Quantity must be positive");
 
-    string memoprefix = "mtt";
-    auto startsWithMTT = transfer_data.memo.rfind(memoprefix, 0);
+    // memo commands are a prefix followed by the order id, eg: mtt42
+    string_view memo{transfer_data.memo};
 
     // Monster Market Transfer
-    if (startsWithMTT == 0) {
+    if (starts_with(memo, "mtt")) {
+
+        _handle_transf(parse_uint64(memo.substr(3)), transfer_data.quantity, transfer_data.from);
+
+    } else if (starts_with(memo, "mtb")) { // Monster Market Bid escrow
 
-        _handle_transf(transfer_data.memo, transfer_data.quantity, transfer_data.from);
+        _handle_bid_transf(parse_uint64(memo.substr(3)), transfer_data.quantity, transfer_data.from);
 
     } else { // in-app transfer
         _tb_accounts accounts(_self, transfer_data.from);
@@ -294,54 +448,49 @@ void pet::transfer(uint64_t sender, uint64_t receiver) {
             });
         }
     }
-
-    // primer roller
-    _random(10);
 }
 
-uint32_t pet::_calc_hunger_hp(const uint8_t &max_hunger_points, const uint32_t &hunger_to_zero,
-    const uint8_t &hunger_hp_modifier, const uint32_t &last_fed_at, const uint32_t &current_time) {
-    // how long it's hungry?
-    uint32_t hungry_seconds = current_time - last_fed_at;
-    uint32_t hungry_points = hungry_seconds * max_hunger_points / hunger_to_zero;
+st_pet_counters pet::_pet_counters(const st_pets &pet) {
+    auto itr_stats = petstats.find(pet.id);
+    return itr_stats != petstats.end() ? *itr_stats : pet.legacy_counters();
+}
 
-    // calculates the effective hunger on hp, if pet hunger is 0
-    uint32_t effect_hp_hunger = 0;
-    if (hungry_points >= max_hunger_points) {
-        effect_hp_hunger = (hungry_points - max_hunger_points) / hunger_hp_modifier;
+// the contract pays the row of legacy pets, battles write it without the
+// owner authority
+_tb_pet_stats::const_iterator pet::_get_pet_stats(const st_pets &pet) {
+    auto itr_stats = petstats.find(pet.id);
+    if (itr_stats == petstats.end()) {
+        itr_stats = petstats.emplace(_self, [&](auto &r) {
+            r = pet.legacy_counters();
+        });
     }
-
-    return effect_hp_hunger;
+    return itr_stats;
 }
 
-bool pet::_is_alive(st_pets &pet, const st_pet_config2 &pc) {
-
-    // auto pc = _get_pet_config();
+st_pet_vitals pet::_pet_vitals(const st_pet_counters &counters, const st_pet_config2 &pc) {
+    st_pet_vitals vitals;
+    vitals.at = now();
+    vitals.sleeping = counters.is_sleeping();
 
-    uint32_t current_time = now();
+    // timestamps ahead of now, like the creation awake time, count as zero
+    uint32_t unfed = vitals.at > counters.last_fed_at ? vitals.at - counters.last_fed_at : 0;
+    uint32_t awake = vitals.at > counters.last_awake_at ? vitals.at - counters.last_awake_at : 0;
 
-    uint32_t effect_hp_hunger = _calc_hunger_hp(pc.max_hunger_points,
-        pc.hunger_to_zero, pc.hunger_hp_modifier,
-        pet.last_fed_at, current_time);
+    // hp is lost only after the hunger bar is empty
+    uint64_t hungry_points = uint64_t{unfed} * pc.max_hunger_points / pc.hunger_to_zero;
+    uint64_t hunger_hp = 0;
+    if (hungry_points > pc.max_hunger_points) {
+        hunger_hp = (hungry_points - pc.max_hunger_points) / pc.hunger_hp_modifier;
+    }
+    vitals.hp = hunger_hp < pc.max_health ? pc.max_health - hunger_hp : 0;
 
-    int32_t hp = pc.max_health - effect_hp_hunger;
+    // energy drains along the day awake and with battles, down to zero
+    uint64_t drained = uint64_t{MAX_ENERGY_POINTS} * awake / DAY + counters.energy_used;
+    vitals.energy = drained < MAX_ENERGY_POINTS ? MAX_ENERGY_POINTS - drained : 0;
 
-    return hp > 0;
+    return vitals;
 }
 
 int pet::_random(const int num) {
-  
-  auto itr_seed = seed.begin();
-  
-  if (itr_seed == seed.end()) {
-    itr_seed = seed.emplace( _self, [&]( auto& r ) { });
-  }
-
-  auto new_seed = (itr_seed->last + now()) % 65537;
-
-  seed.modify( itr_seed, _self, [&]( auto& s ) {
-    s.last = new_seed;
-  });
-
-  return new_seed % num;
+  return _entropy.roll(num);
 }
@@ -1,174 +1,145 @@
 using namespace types;
 using namespace utils;
 
-bool _roll_and_test(const int &now, int &primer, int per_ten_thounsad) {
-  primer = (primer + now) % 65537;
-  return (primer % 10000) < per_ten_thounsad;
+void pet::openchest(name player) {
+  openchests(player, 1);
 }
 
-void pet::openchest(name player) {
+void pet::openchests(name player, uint16_t count) {
 
   require_auth(player);
 
-  auto itr_account = accounts2.find(player);
-  eosio_assert(itr_account != accounts2.end(), "account is not signed up");
+  eosio_assert(count > 0 && count <= MAX_CHESTS_OPEN, "invalid number of chests to open");
+
+  auto itr_account = _get_account(player, "account is not signed up");
 
   // add daily chest
-  st_account2 account = *itr_account;
-  bool is_daily_chest = (now() - account.actions[OPEN_DAILY_CHEST]) >= (24 * HOUR);
+  bool is_daily_chest = (now() - itr_account->action_at(OPEN_DAILY_CHEST)) >= (24 * HOUR);
   if (is_daily_chest) {
-    SEND_INLINE_ACTION( *this, issueitem, {_self,N(active)}, {player, asset{1, CHEST}, "dailychest"} );
+    _add_item(player, asset{1, CHEST});
 
     // updates last received dailychest
-    accounts2.modify(itr_account, 0, [&](auto &r) {
-      r.actions[OPEN_DAILY_CHEST] = now();
+    accounts3.modify(itr_account, 0, [&](auto &r) {
+      r.set_action_at(OPEN_DAILY_CHEST, now());
     });
-  } else {
-    eosio_assert(account.assets[CHEST] >= 1, "player has no chest to open");
   }
 
-  // schedule reward in next 3 secs
-  transaction trx{};
-  trx.actions.emplace_back(
-      permission_level{_self, N(active)},
-      _self, N(chestreward),
-      std::make_tuple(player, 1, "openchest")
-  );
-  trx.delay_sec = 1 + _random(3);
-  trx.send(1, _self);
+  // chests are reserved now so a second openchests can't schedule them again
+  _tb_loot_tables loottables(_self, _self);
+  eosio_assert(loottables.begin() != loottables.end(), "loot tables are not set");
+  _sub_item(player, asset{count, CHEST}, "player has no chest to open");
+
+  _schedule_chests(player, count, _item_balance(player, CHEST));
 }
 
 void pet::issueitem( name player, asset item, string reason) {
   require_auth(_self);
 
-  auto itr_account = accounts2.find(player);
-  eosio_assert(itr_account != accounts2.end(), "account is not signed up");
+  _add_item(player, item);
+}
 
-  eosio_assert(item.is_valid(), "Invalid item issue");
-  eosio_assert(item.amount > 0, "Quantity must be positive");
+void pet::issueitems( name player, vector<asset> items, string /* reason */ ) {
+  require_auth(_self);
 
-  accounts2.modify(itr_account, 0, [&](auto &r) {
-    r.add_asset(item.symbol, item.amount);
-  });
+  _add_items(player, items);
 }
 
-void pet::issueitems( name player, vector<asset> items, string /* reason */ ) {
+void pet::chestreward(name player, uint8_t modifier, string reason) {
+  chestrewards(player, 1, modifier, reason);
+}
+
+void pet::chestrewards(name player, uint16_t count, uint8_t modifier, string reason) {
   require_auth(_self);
 
-  auto itr_account = accounts2.find(player);
-  eosio_assert(itr_account != accounts2.end(), "account is not signed up");
+  eosio_assert(count > 0 && count <= MAX_CHESTS_OPEN, "invalid number of chests to open");
 
-  accounts2.modify(itr_account, 0, [&](auto &r) {
-    for (auto item : items) {
-      eosio_assert(item.is_valid(), "Invalid item issue");
-      eosio_assert(item.amount > 0, "Quantity must be positive");
-      r.add_asset(item.symbol, item.amount);
-    }
-  });
+  // chests were taken by openchests, credits in place and logs the rolled
+  // items inline for history
+  auto items = _roll_chest_rewards(count, modifier);
+  _add_items(player, items);
+
+  SEND_INLINE_ACTION(*this, itemsissued, {_self,N(active)}, {player, items, reason});
 }
 
-void pet::chestreward(name player, uint8_t modifier, string reason) {
+void pet::itemsissued(name player, vector<asset> /* items */, string /* reason */) {
   require_auth(_self);
-  
-  auto itr_account = accounts2.find(player);
-  eosio_assert(itr_account != accounts2.end(), "account is not signed up");
-
-  // check chest balance
-  st_account2 account = *itr_account;
-  auto player_chests = account.assets[CHEST];
-  eosio_assert(player_chests >= 1, "player has no chest to open");
-
-  // reduce chest balance
-  accounts2.modify(itr_account, 0, [&](auto &r) {
-    r.assets[CHEST] = player_chests - 1;
-  });
-
-  int base = _random(65537);
-  int primer = base;
-  int timestamp = now();
-
-  // calc rewards
-  int candies = (1 + (primer % 4)) * modifier;
-  bool energy_drink = _roll_and_test(timestamp, primer, 500 * modifier);
-  bool small_hp_potion = _roll_and_test(timestamp, primer, 2000 * modifier);
-  bool medium_hp_potion = _roll_and_test(timestamp, primer, 1000 * modifier);
-  bool large_hp_potion = _roll_and_test(timestamp, primer, 500 * modifier);
-  bool total_hp_potion = _roll_and_test(timestamp, primer, 100 * modifier);
-  bool attack_elixir = _roll_and_test(timestamp, primer, 100 * modifier);
-  bool super_attack_elixir = _roll_and_test(timestamp, primer, 50 * modifier);
-  bool defense_elixir = _roll_and_test(timestamp, primer, 100 * modifier);
-  bool super_defense_elixir = _roll_and_test(timestamp, primer, 50 * modifier);
-  bool ihp_elixir = _roll_and_test(timestamp, primer, 100 * modifier);
-  bool super_ihp_elixir = _roll_and_test(timestamp, primer, 50 * modifier);
-  bool xp_bronze_scroll = _roll_and_test(timestamp, primer, 50 * modifier);
-  bool xp_silver_scroll = _roll_and_test(timestamp, primer, 25 * modifier);
-  bool xp_gold_scroll = _roll_and_test(timestamp, primer, 10 * modifier);
-  bool sxp_bronze_scroll = _roll_and_test(timestamp, primer, 25 * modifier);
-  bool sxp_silver_scroll = _roll_and_test(timestamp, primer, 10 * modifier);
-  bool sxp_gold_scroll = _roll_and_test(timestamp, primer, 5 * modifier);
-  bool revive_tome = _roll_and_test(timestamp, primer, 1 * modifier);
-
-  // increment items balance
+
+  // no-op, keeps the issued items in the action traces
+  require_recipient(player);
+}
+
+void pet::_schedule_chests(name player, uint16_t count, uint64_t chests_left) {
+
+  // schedule reward in next 3 secs, a single deferred trx for all chests
+  transaction trx{};
+  trx.actions.emplace_back(
+      permission_level{_self, N(active)},
+      _self, N(chestrewards),
+      std::make_tuple(player, count, uint8_t{1}, string{"openchest"})
+  );
+  trx.delay_sec = 1 + _random(3);
+
+  // the chests left tell apart two openchests within the same transaction,
+  // where the time is the same
+  trx.send(combine_ids(player, (uint64_t{now()} << 32) | chests_left), _self);
+}
+
+vector<asset> pet::_roll_chest_rewards(uint16_t count, uint8_t modifier) {
+
+  _tb_loot_tables loottables(_self, _self);
+  eosio_assert(loottables.begin() != loottables.end(), "loot tables are not set");
+
+  // aggregates all the chests draws before touching any balance
+  flat_map<symbol_type, int64_t> drops;
+  uint32_t draws = uint32_t{count} * modifier;
+  for (auto& table : loottables) {
+    for (uint32_t i = 0; i < draws; i++) {
+      const auto& entry = table.pick(_entropy.next());
+
+      uint32_t quantity = entry.min_quantity;
+      if (entry.max_quantity > entry.min_quantity) {
+        quantity += _entropy.roll(uint64_t{entry.max_quantity - entry.min_quantity} + 1);
+      }
+
+      if (quantity > 0) drops[entry.symbol] += quantity;
+    }
+  }
+
   vector<asset> items{};
-  items.emplace_back(asset{candies, CANDY});
-  if (energy_drink) items.emplace_back(asset{1, ENERGY_DRINK});
-  if (small_hp_potion) items.emplace_back(asset{1, SMALL_HP_POTION});
-  if (medium_hp_potion) items.emplace_back(asset{1, MEDIUM_HP_POTION});
-  if (large_hp_potion) items.emplace_back(asset{1, LARGE_HP_POTION});
-  if (total_hp_potion) items.emplace_back(asset{1, TOTAL_HP_POTION});
-  if (attack_elixir) items.emplace_back(asset{1, INCREASED_ATTACK_ELIXIR});
-  if (super_attack_elixir) items.emplace_back(asset{1, SUPER_ATTACK_ELIXIR});
-  if (defense_elixir) items.emplace_back(asset{1, INCREASED_DEFENSE_ELIXIR});
-  if (super_defense_elixir) items.emplace_back(asset{1, SUPER_DEFENSE_ELIXIR});
-  if (ihp_elixir) items.emplace_back(asset{1, INCREASED_HP_ELIXIR});
-  if (super_ihp_elixir) items.emplace_back(asset{1, SUPER_HP_ELIXIR});
-  if (xp_bronze_scroll) items.emplace_back(asset{1, BRONZE_XP_SCROLL});
-  if (xp_silver_scroll) items.emplace_back(asset{1, SILVER_XP_SCROLL});
-  if (xp_gold_scroll) items.emplace_back(asset{1, GOLD_XP_SCROLL});
-  if (sxp_bronze_scroll) items.emplace_back(asset{1, BRONZE_XP_SCROLL});
-  if (sxp_silver_scroll) items.emplace_back(asset{1, SILVER_XP_SCROLL});
-  if (sxp_gold_scroll) items.emplace_back(asset{1, GOLD_XP_SCROLL});
-  if (revive_tome) items.emplace_back(asset{1, REVIVE_TOME});
-  
-  SEND_INLINE_ACTION( *this, issueitems, {_self,N(active)}, {player, items, reason} );
+  for (auto& drop : drops) {
+    items.emplace_back(asset{drop.second, drop.first});
+  }
+
+  return items;
 }
 
 void pet::petconsume(uuid pet_id, symbol_type item) {
 
     auto itr_pet = pets.find(pet_id);
     eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
-    st_pets pet = *itr_pet;
+    const auto& pet = *itr_pet;
 
     require_auth(pet.owner);
 
-    auto pc = _get_pet_config();
+    const auto& pc = _get_pet_config();
 
-    eosio_assert(_is_alive(pet, pc) || item == REVIVE_TOME, "deads don't consume anything");
-    eosio_assert(!pet.is_sleeping(), "pet is sleeping");
+    auto itr_stats = _get_pet_stats(pet);
+    auto vitals = _pet_vitals(*itr_stats, pc);
+    eosio_assert(vitals.is_alive() || item == REVIVE_TOME, "deads don't consume anything");
+    eosio_assert(!vitals.sleeping, "pet is sleeping");
 
     // check the item balance
-    auto itr_account = accounts2.find(pet.owner);
-    eosio_assert(itr_account != accounts2.end(), "pet owner is not signed up");
-
-    st_account2 account = *itr_account;
-    auto balance = account.assets[item];
-    eosio_assert(balance >= 1, "player does not have the item to consume");
-    accounts2.modify(itr_account, 0, [&](auto &r) {
-        r.assets[item] = balance - 1;
-    });
+    _sub_item(pet.owner, asset{1, item}, "player does not have the item to consume");
 
     // execute consumption action here
     if (item == ENERGY_DRINK) {
-      eosio_assert(pet.energy_drinks < MAX_DAILY_ENERGY_DRINKS, "you can only consume 10 energy drinks per day");
-      pets.modify(itr_pet, 0, [&](auto &r) {
+      eosio_assert(itr_stats->energy_drinks < MAX_DAILY_ENERGY_DRINKS, "you can only consume 10 energy drinks per day");
+      petstats.modify(itr_stats, 0, [&](auto &r) {
         r.energy_drinks = r.energy_drinks + 1;
         r.energy_used = 0;
       });
     } else {
       eosio_assert(false, "item not implemented");
     }
-
-    // primer roller
-    _random(10);
     
 }
@@ -30,12 +30,14 @@ void pet::orderask(uuid pet_id, name new_owner, asset amount, uint32_t until = 0
         auto order = *itr_user_pet;
 
         eosio_assert(order.type != ORDER_TYPE_RENTING, "order can't be updated during temporary transfers");
+        eosio_assert(order.type != ORDER_TYPE_BID_ESCROW, "remove your escrowed bid before placing an ask");
 
         orders.modify(*itr_user_pet, pet.owner, [&](auto &r) {
             r.value = amount;
             r.new_owner = new_owner;
             r.type = type;
             r.placed_at = placed_at;
+            r.ends_at = placed_at + ORDER_TTL;
             r.transfer_ends_at = until;
         });
     } else {
@@ -48,7 +50,7 @@ void pet::orderask(uuid pet_id, name new_owner, asset amount, uint32_t until = 0
                 .type = type,
                 .value = amount,
                 .placed_at = placed_at,
-                .ends_at = 0,
+                .ends_at = placed_at + ORDER_TTL,
                 .transfer_ends_at = until};
             r = order;
         });
@@ -60,6 +62,11 @@ void pet::orderask(uuid pet_id, name new_owner, asset amount, uint32_t until = 0
     }
 
     print("new owner can become ", new_owner);
+
+    // settles right away when an escrowed bid already covers the ask
+    if (type == ORDER_TYPE_ASK) {
+        _match_ask(idx_existent_order.get(user_pet_id).id);
+    }
 }
 
 void pet::removeask(name owner, uuid pet_id) {
@@ -72,6 +79,7 @@ void pet::removeask(name owner, uuid pet_id) {
     eosio_assert(order.user == owner, "order can only be removed by owner of order");
 
     eosio_assert(order.type != ORDER_TYPE_RENTING, "orders can't be removed during temporary transfers");
+    eosio_assert(order.type != ORDER_TYPE_BID_ESCROW, "escrowed bids must be removed with removebid");
 
     orders.erase(order);
 }
@@ -91,11 +99,11 @@ void pet::claimpet(name old_owner, uuid pet_id, name claimer) {
     eosio_assert(old_owner == pet.owner, "Pet already transferred");
 
     eosio_assert(order.type != ORDER_TYPE_RENTING || order.transfer_ends_at < now(), "E404|Temporary transfer not yet over");
+    eosio_assert(!order.is_expired(now()), "E404|order expired");
     eosio_assert(order.value.amount == 0, "orders requires value transfer");
 
     // transfer pet
-    SEND_INLINE_ACTION( *this, transferpet, {_self,N(active)}, {pet.id, claimer});
-    // _transfer_pet(pet.id, claimer);
+    _transfer_pet(pet.id, claimer);
 
     if (order.transfer_ends_at > 0) {
         if (order.type == ORDER_TYPE_ASK_RENT) {
@@ -104,6 +112,7 @@ void pet::claimpet(name old_owner, uuid pet_id, name claimer) {
                 r.new_owner = old_owner;
                 r.value = asset(0); // transfer back is for free
                 r.type = ORDER_TYPE_RENTING;
+                r.ends_at = 0; // rentals are returned by rentsweep
             });
             print("order converter to temporary transfer");
         } else if (order.type == ORDER_TYPE_RENTING) {
@@ -145,9 +154,12 @@ void pet::bidpet(uuid pet_id, name bidder, asset amount, uint32_t until = 0) {
     if (itr_user_pet != idx_existent_order.end()) {
         auto order = *itr_user_pet;
 
-        orders.modify(*itr_user_pet, pet.owner, [&](auto &r) {
+        eosio_assert(order.type != ORDER_TYPE_BID_ESCROW, "escrowed bids can't be updated, remove it first");
+
+        orders.modify(*itr_user_pet, bidder, [&](auto &r) {
             r.value = amount;
             r.placed_at = placed_at;
+            r.ends_at = placed_at + ORDER_TTL;
             r.transfer_ends_at = until;
         });
     } else {
@@ -159,7 +171,7 @@ void pet::bidpet(uuid pet_id, name bidder, asset amount, uint32_t until = 0) {
                 .type = type,
                 .value = amount,
                 .placed_at = placed_at,
-                .ends_at = 0,
+                .ends_at = placed_at + ORDER_TTL,
                 .transfer_ends_at = until};
             r = order;
         });
@@ -175,26 +187,118 @@ void pet::removebid(name bidder, uuid pet_id) {
 
     eosio_assert(order.user == bidder, "E404|bids can only be removed by owner of bid");
 
+    if (order.type == ORDER_TYPE_BID_ESCROW) {
+        _refund_bid(order);
+    }
+
     orders.erase(order);
 }
 
-// void pet::_transfer_pet(uuid pet_id, name new_owner) {
+void pet::claimrefund(name owner) {
+
+    require_auth(owner);
+
+    _tb_refunds refunds(_self, _self);
+    const auto& refund = refunds.get(owner, "E404|No refund to claim");
+
+    asset balance = refund.balance;
+    refunds.erase(refund);
+
+    _transfer_value(owner, balance, "MonsterEOS refund");
+}
+
+// erases expired asks and bids, oldest first, refunding escrowed bids;
+// reschedules itself for the next order due
+void pet::ordersweep(uint16_t limit) {
+    require_auth(_self);
+
+    eosio_assert(limit > 0 && limit <= MAX_ORDER_SWEEP, "invalid sweep limit");
 
-//     auto itr_pet = pets.find(pet_id);
-//     eosio_assert(itr_pet != pets.end(), "E404|Invalid pet");
-//     auto pet = *itr_pet;
+    auto idx_ends_at = orders.get_index<N(byendsat)>();
+    auto itr_order = idx_ends_at.lower_bound(1);
+    uint32_t current_time = now();
+
+    uint16_t erased = 0;
+    while (itr_order != idx_ends_at.end() && erased < limit && itr_order->is_expired(current_time)) {
+        if (itr_order->type == ORDER_TYPE_BID_ESCROW) {
+            _refund_bid(*itr_order);
+        }
+        itr_order = idx_ends_at.erase(itr_order);
+        erased++;
+    }
+
+    uint32_t delay = ORDER_SWEEP_INTERVAL;
+    if (itr_order != idx_ends_at.end()) {
+        uint32_t ends_at = itr_order->ends_at;
+        delay = ends_at <= current_time ? 1 : std::min(ends_at - current_time, ORDER_SWEEP_INTERVAL);
+    }
+
+    print("\nexpired orders: ", erased);
+
+    transaction trx{};
+    trx.actions.emplace_back(
+        permission_level{_self, N(active)},
+        _self, N(ordersweep),
+        std::make_tuple(limit)
+    );
+    trx.delay_sec = delay;
+    trx.send(N(ordersweep), _self, true);
+}
 
-//     print(pet_id, "| transfering pet ");
+// returns expired rentals to their owners, oldest first, and reschedules
+// itself for the next rental due
+void pet::rentsweep(uint16_t limit) {
+    require_auth(_self);
 
-//     pets.modify(itr_pet, 0, [&](auto &r) {
-//         r.owner = new_owner;
-//     });
-// }
+    eosio_assert(limit > 0 && limit <= MAX_RENT_SWEEP, "invalid sweep limit");
 
-void pet::_handle_transf(string memo, asset quantity, account_name from) {
+    auto idx_type_ends = orders.get_index<N(bytypeends)>();
+    auto itr_order = idx_type_ends.lower_bound(combine_ids(ORDER_TYPE_RENTING, 0));
+    uint32_t current_time = now();
+
+    vector<uuid> expired{};
+    uint16_t visited = 0;
+    for (; itr_order != idx_type_ends.end() && visited < limit; itr_order++, visited++) {
+        if (itr_order->type != ORDER_TYPE_RENTING || itr_order->transfer_ends_at >= current_time) break;
+
+        // pets in battle go back on a later run
+        const auto& pet = pets.get(itr_order->pet_id, "E404|Invalid pet");
+        if (!_pet_in_battle(pet)) {
+            expired.emplace_back(itr_order->id);
+        }
+    }
+
+    uint32_t delay = RENT_SWEEP_INTERVAL;
+    if (itr_order != idx_type_ends.end() && itr_order->type == ORDER_TYPE_RENTING) {
+        uint32_t ends_at = itr_order->transfer_ends_at;
+        delay = ends_at < current_time ? 1 : std::min(ends_at - current_time + 1, RENT_SWEEP_INTERVAL);
+    }
+
+    for (auto& order_id : expired) {
+        auto itr_expired = orders.find(order_id);
+        const auto& pet = pets.get(itr_expired->pet_id, "E404|Invalid pet");
+
+        // renter is order user, owner is order new_owner
+        if (pet.owner == itr_expired->user) {
+            _set_owner(pet.id, itr_expired->new_owner);
+        }
+        orders.erase(itr_expired);
+    }
+
+    print("\nreturned rentals: ", expired.size());
+
+    transaction trx{};
+    trx.actions.emplace_back(
+        permission_level{_self, N(active)},
+        _self, N(rentsweep),
+        std::make_tuple(limit)
+    );
+    trx.delay_sec = delay;
+    trx.send(N(rentsweep), _self, true);
+}
+
+void pet::_handle_transf(uuid orderid, const asset &quantity, account_name from) {
 
-    string sorderid = memo.substr(3);
-    auto orderid = stoi(sorderid);
     print("\ntransfer received for order ", orderid);
 
     auto itr_order = orders.find(orderid);
@@ -212,26 +316,185 @@ void pet::_handle_transf(string memo, asset quantity, account_name from) {
     auto pet = *itr_pet;
 
     eosio_assert(order.type != 10, "order is already RENTING");
+    eosio_assert(!order.is_expired(now()), "order expired");
     eosio_assert(order.user != from, "You cant buy your own order DUH");
     eosio_assert(pet.owner == order.user, "monster does not to belong to order's user");
 
     eosio_assert(quantity.symbol == order.value.symbol, "token does not match order's token");
 
-    auto pc = _get_pet_config();
-    auto order_amount = order.value.amount * (1 + (pc.market_fee / 10000 ));
-    eosio_assert(quantity.amount > order_amount,
+    const auto& pc = _get_pet_config();
+    asset price = order.value + _market_fee(order.value, pc);
+    eosio_assert(quantity >= price,
         "amount is not sufficient to pay for offer's amount and market fees");
 
     name old_owner = pet.owner;
-    // pets.modify(itr_pet, 0, [&](auto &r) {
-    //     r.owner = name{from};
-    // });
-    SEND_INLINE_ACTION( *this, transferpet, {_self,N(active)}, {pet.id, name{from}});
+    _set_owner(pet.id, name{from});
 
     orders.erase(itr_order);
 
     // transfer money to old owner
-    _transfer_value(old_owner, order.value, "MonsterEOS order " + sorderid);
+    _transfer_value(old_owner, order.value, "MonsterEOS order " + std::to_string(orderid));
+}
+
+void pet::_handle_bid_transf(uuid orderid, const asset &quantity, account_name from) {
+
+    print("\ntransfer received for bid ", orderid);
+
+    const auto& order = orders.get(orderid, "E404|Invalid order");
+
+    eosio_assert(order.type == ORDER_TYPE_BID, "only open bids can be funded");
+    eosio_assert(!order.is_expired(now()), "bid expired");
+    eosio_assert(order.user == from, "bids can only be funded by the bidder");
+    eosio_assert(quantity.symbol == order.value.symbol, "token does not match order's token");
+
+    const auto& pet = pets.get(order.pet_id, "E404|Invalid pet");
+    eosio_assert(pet.owner != order.user, "bidder must be different than current owner");
+
+    const auto& pc = _get_pet_config();
+    asset escrow = order.value + _market_fee(order.value, pc);
+    eosio_assert(quantity == escrow, "transfer must match bid value plus market fees");
+
+    orders.modify(order, 0, [&](auto &r) {
+        r.type = ORDER_TYPE_BID_ESCROW;
+    });
+
+    // a notification can't bill the bidder, the row is freed on refund or
+    // settlement
+    _tb_bid_escrows escrows(_self, _self);
+    escrows.emplace(_self, [&](auto &r) {
+        r.order_id = orderid;
+        r.escrow = quantity;
+    });
+
+    _match_bid(orderid);
+}
+
+// gives back the escrowed bid with the fees reserved for it, as a
+// refund the bidder withdraws with claimrefund
+void pet::_refund_bid(const st_orders &bid) {
+    _tb_bid_escrows escrows(_self, _self);
+    const auto& escrow = escrows.get(bid.id, "E404|Invalid bid escrow");
+    _credit_refund(bid.user, escrow.escrow);
+    escrows.erase(escrow);
+}
+
+asset pet::_market_fee(const asset &value, const st_pet_config2 &pc) {
+    return asset(value.amount * pc.market_fee / 10000, value.symbol);
+}
+
+asset pet::_bid_escrow(uuid bid_id) {
+    _tb_bid_escrows escrows(_self, _self);
+    return escrows.get(bid_id, "E404|Invalid bid escrow").escrow;
+}
+
+// market funds are never pushed to the counterparty, a receiver that
+// rejects notifications would otherwise block the trade
+void pet::_credit_refund(name owner, asset quantity) {
+    _tb_refunds refunds(_self, _self);
+    auto itr_refund = refunds.find(owner);
+
+    if (itr_refund == refunds.end()) {
+        refunds.emplace(_self, [&](auto &r) {
+            r.owner = owner;
+            r.balance = quantity;
+        });
+    } else {
+        refunds.modify(itr_refund, 0, [&](auto &r) {
+            r.balance += quantity;
+        });
+    }
+}
+
+void pet::_match_ask(uuid ask_id) {
+    const auto& ask = orders.get(ask_id, "E404|Invalid order");
+
+    // best escrowed bid for the pet, earliest one wins a tie
+    auto idx_pet_type = orders.get_index<N(bypettype)>();
+    auto pet_type = combine_ids(ask.pet_id, ORDER_TYPE_BID_ESCROW);
+    auto itr_bid = idx_pet_type.lower_bound(pet_type);
+    auto itr_best = idx_pet_type.end();
+
+    const auto& pc = _get_pet_config();
+    asset price = ask.value + _market_fee(ask.value, pc);
+    uint32_t current_time = now();
+    for (; itr_bid != idx_pet_type.end() && itr_bid->get_by_pet_and_type() == pet_type; itr_bid++) {
+        if (itr_bid->is_expired(current_time)) continue;
+        if (itr_bid->value < ask.value) continue;
+        if (_bid_escrow(itr_bid->id) < price) continue;
+        if (ask.new_owner != (const name) {0} && itr_bid->user != ask.new_owner) continue;
+
+        if (itr_best == idx_pet_type.end() ||
+            itr_bid->value > itr_best->value ||
+            (itr_bid->value == itr_best->value && itr_bid->placed_at < itr_best->placed_at)) {
+            itr_best = itr_bid;
+        }
+    }
+
+    if (itr_best != idx_pet_type.end()) {
+        _settle_orders(ask_id, itr_best->id);
+    }
+}
+
+void pet::_match_bid(uuid bid_id) {
+    const auto& bid = orders.get(bid_id, "E404|Invalid order");
+    const auto& pet = pets.get(bid.pet_id, "E404|Invalid pet");
+
+    auto idx_existent_order = orders.get_index<N(by_user_and_pet)>();
+    auto itr_ask = idx_existent_order.find(combine_ids(pet.owner, pet.id));
+
+    if (itr_ask == idx_existent_order.end() ||
+        itr_ask->type != ORDER_TYPE_ASK ||
+        itr_ask->is_expired(now()) ||
+        itr_ask->value > bid.value ||
+        (itr_ask->new_owner != (const name) {0} && itr_ask->new_owner != bid.user)) {
+        return;
+    }
+
+    const auto& pc = _get_pet_config();
+    if (_bid_escrow(bid_id) < itr_ask->value + _market_fee(itr_ask->value, pc)) {
+        return;
+    }
+
+    _settle_orders(itr_ask->id, bid_id);
+}
+
+void pet::_settle_orders(uuid ask_id, uuid bid_id) {
+    auto itr_ask = orders.find(ask_id);
+    auto itr_bid = orders.find(bid_id);
+    eosio_assert(itr_ask != orders.end() && itr_bid != orders.end(), "E404|Invalid order");
+
+    auto ask = *itr_ask;
+    auto bid = *itr_bid;
+
+    const auto& pet = pets.get(ask.pet_id, "E404|Invalid pet");
+    eosio_assert(pet.owner == ask.user, "monster does not to belong to order's user");
+    eosio_assert(bid.type == ORDER_TYPE_BID_ESCROW, "bid is not escrowed");
+
+    // trade settles at the ask price, bidder gets back what is left of
+    // the deposit
+    const auto& pc = _get_pet_config();
+    _tb_bid_escrows escrows(_self, _self);
+    const auto& bid_escrow = escrows.get(bid.id, "E404|Invalid bid escrow");
+    asset escrow = bid_escrow.escrow;
+    asset paid = ask.value + _market_fee(ask.value, pc);
+    eosio_assert(escrow >= paid, "bid escrow does not cover the ask");
+    escrows.erase(bid_escrow);
+
+    _set_owner(pet.id, bid.user);
+
+    orders.erase(itr_ask);
+    orders.erase(itr_bid);
+
+    if (ask.value.amount > 0) {
+        _credit_refund(ask.user, ask.value);
+    }
+
+    asset change = escrow - paid;
+    if (change.amount > 0) {
+        _credit_refund(bid.user, change);
+    }
+
+    print("order ", ask.id, " matched with bid ", bid.id);
 }
 
 void pet::_transfer_value(name receiver, asset quantity, string memo) {
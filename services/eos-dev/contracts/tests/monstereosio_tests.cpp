@@ -4,6 +4,7 @@
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/test/unit_test.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <Runtime/Runtime.h>
@@ -221,6 +222,101 @@ public:
     }
   }
 
+  // monstereosio row as a variant, null when the row does not exist
+  fc::variant get_row(name table, const std::string& type, uint64_t pk,
+                      name scope = "monstereosio"_n) {
+    auto table_row = get_table_row("monstereosio"_n, scope, table, pk);
+    if (table_row.value.empty())
+      return fc::variant();
+    return abi_ser.binary_to_variant(type, table_row.value, abi_serializer_max_time);
+  }
+
+  // eosio.token with EOS issued to the holders, monstereosio pays out
+  // through inline transfers with its eosio.code permission
+  void deploy_token(const std::vector<name>& holders) {
+    create_account("eosio.token"_n);
+    set_code("eosio.token"_n, contracts::token_wasm());
+    set_abi("eosio.token"_n, contracts::token_abi().data());
+
+    push_action("eosio.token"_n, "create"_n, "eosio.token"_n,
+                mvo()("issuer", "eosio.token")("maximum_supply", "1000000000.0000 EOS"));
+    for (auto& holder : holders)
+      push_action("eosio.token"_n, "issue"_n, "eosio.token"_n,
+                  mvo()("to", holder)("quantity", "1000.0000 EOS")("memo", ""));
+
+    set_authority("monstereosio"_n, config::active_name,
+                  authority(1, {key_weight{get_public_key("monstereosio"_n, "active"), 1}},
+                            {permission_level_weight{{"monstereosio"_n, config::eosio_code_name}, 1}}),
+                  config::owner_name);
+    produce_blocks();
+  }
+
+  void eos_transfer(name from, name to, const std::string& quantity, const std::string& memo) {
+    push_action("eosio.token"_n, "transfer"_n, from,
+                mvo()("from", from)("to", to)("quantity", quantity)("memo", memo));
+  }
+
+  asset eos_balance(name owner) {
+    auto balance = get_table_row("eosio.token"_n, owner, "accounts"_n,
+                                 symbol(4, "EOS").to_symbol_code().value);
+    if (balance.value.empty())
+      return asset(0, symbol(4, "EOS"));
+    return fc::raw::unpack<asset>(balance.value);
+  }
+
+  // account code that fails every action it receives, used for accounts
+  // that refuse monstereosio notifications
+  void reject_notifications(name account) {
+    set_code(account, R"=====(
+(module
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (memory $0 1)
+ (export "memory" (memory $0))
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+  (call $eosio_assert (i32.const 0) (i32.const 8)))
+ (data (i32.const 8) "notification rejected\00")
+)
+)=====");
+    produce_blocks();
+  }
+
+  // whether account was notified by any action of the trace
+  static bool notified(const transaction_trace_ptr& trace, name account) {
+    std::function<bool(const action_trace&)> visit = [&](const action_trace& at) {
+      if (at.receipt.receiver == account)
+        return true;
+      for (auto& inline_trace : at.inline_traces)
+        if (visit(inline_trace))
+          return true;
+      return false;
+    };
+    for (auto& at : trace->action_traces)
+      if (visit(at))
+        return true;
+    return false;
+  }
+
+  // bytes the player items take, accounts3 row plus one inventory row
+  // per held item
+  size_t items_size(name player) {
+    size_t size = get_table_row("monstereosio"_n, "monstereosio"_n, "accounts3"_n, player).value.size();
+    for (auto& item : get_table("monstereosio"_n, player, "inventory"_n))
+      size += item.value.size();
+    return size;
+  }
+
+  // several monstereosio actions in a single transaction signed by signer
+  transaction_trace_ptr push_actions(name signer, const std::vector<std::pair<name, variant_object>>& actions) {
+    signed_transaction trx;
+    for (auto& act : actions)
+      trx.actions.emplace_back(get_action("monstereosio"_n, act.first,
+                                          vector<permission_level>{{signer, config::active_name}}, act.second));
+    set_transaction_headers(trx);
+    trx.sign(get_private_key(signer, "active"), control->get_chain_id());
+    return push_transaction(trx);
+  }
+
   void diff_table(name account, name scope, name table, const std::string& type,
                   std::vector<row>& existing) {
     outfile << "table: " << account << " " << scope << " " << table << "\n";
@@ -552,7 +648,8 @@ BOOST_AUTO_TEST_SUITE(monstereosio)
 
 BOOST_AUTO_TEST_CASE(singuprewards) try {
   monstereosio_tester        t{"signuprewards"};
-  monstereosio_tester::table accounts2{"monstereosio"_n, "monstereosio"_n, "accounts2"_n, "st_account2"};
+  monstereosio_tester::table accounts3{"monstereosio"_n, "monstereosio"_n, "accounts3"_n, "st_account3"};
+  monstereosio_tester::table inventory{"monstereosio"_n, "john"_n, "inventory"_n, "st_inventory_item"};
   
   t.create_account("john"_n);
   t.create_account("mary"_n);
@@ -561,44 +658,58 @@ BOOST_AUTO_TEST_CASE(singuprewards) try {
   t.create_account("rocket"_n);
   t.produce_blocks();
 
+  t.heading("loot tables");
+  t.push_trx("monstereosio", "setloottable", "monstereosio",
+    R"({"id": 0, "entries": [{"symbol": "0,CANDY", "weight": 1, "min_quantity": 1, "max_quantity": 4}]})");
+  t.push_trx("monstereosio", "setloottable", "monstereosio",
+    R"({"id": 1, "entries": [
+      {"symbol": "0,CANDY", "weight": 5324, "min_quantity": 0, "max_quantity": 0},
+      {"symbol": "0,SHPPT", "weight": 2000, "min_quantity": 1, "max_quantity": 1},
+      {"symbol": "0,MHPPT", "weight": 1000, "min_quantity": 1, "max_quantity": 1},
+      {"symbol": "0,ENGYD", "weight": 500, "min_quantity": 1, "max_quantity": 1},
+      {"symbol": "0,REVIV", "weight": 1, "min_quantity": 1, "max_quantity": 1}]})");
+  t.produce_blocks();
+
   t.heading("signup: signup");
   t.push_trx("monstereosio", "signup", "john",
     R"({"user": "john"})");
-  t.diff_table(accounts2);
+  t.diff_table(accounts3);
   t.produce_blocks(5);
 
-  auto acc_row = t.get_table_row("monstereosio"_n, "monstereosio"_n, "accounts2"_n, "john"_n);
-  BOOST_TEST_MESSAGE( "John Account RAM Size: " << acc_row.value.size() );
+  // no inventory row is opened before the player holds an item
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "john"_n, "inventory"_n).empty());
+  BOOST_TEST_MESSAGE( "John Items RAM Size: " << t.items_size("john"_n) );
   t.produce_blocks(5);
 
   t.push_trx("monstereosio", "openchest", "john",
     R"({"player": "john"})");
-  t.diff_table(accounts2);
+  t.diff_table(accounts3);
   t.produce_blocks(10);
-  t.diff_table(accounts2);
+  t.diff_table(accounts3);
 
-  acc_row = t.get_table_row("monstereosio"_n, "monstereosio"_n, "accounts2"_n, "john"_n);
-  BOOST_TEST_MESSAGE( "John Account RAM Size: " << acc_row.value.size() );
+  BOOST_TEST_MESSAGE( "John Items RAM Size: " << t.items_size("john"_n) );
   t.produce_blocks(5);
 
   t.push_trx("monstereosio", "openchest", "john",
     R"({"player": "john"})");
-  t.diff_table(accounts2);
+  t.diff_table(accounts3);
   t.produce_blocks(10);
-  t.diff_table(accounts2);
+  t.diff_table(accounts3);
 
-  acc_row = t.get_table_row("monstereosio"_n, "monstereosio"_n, "accounts2"_n, "john"_n);
-  BOOST_TEST_MESSAGE( "John Account RAM Size: " << acc_row.value.size() );
+  BOOST_TEST_MESSAGE( "John Items RAM Size: " << t.items_size("john"_n) );
   t.produce_blocks(5);
 
   t.heading("super gift test!");
   t.push_trx("monstereosio", "chestreward", "monstereosio",
     R"({"player": "john", "modifier": 20, "reason": "just a test"})");
-  t.diff_table(accounts2);
+  t.diff_table(accounts3);
+  t.diff_table(inventory);
   t.produce_blocks(5);
 
-  acc_row = t.get_table_row("monstereosio"_n, "monstereosio"_n, "accounts2"_n, "john"_n);
-  BOOST_TEST_MESSAGE( "John Account RAM Size: " << acc_row.value.size() );
+  for (auto& item : t.get_table("monstereosio"_n, "john"_n, "inventory"_n))
+    BOOST_REQUIRE(fc::raw::unpack<asset>(item.value).get_amount() > 0);
+
+  BOOST_TEST_MESSAGE( "John Items RAM Size: " << t.items_size("john"_n) );
   t.produce_blocks(5);
 
   // t.push_trx("monstereosio", "createpet", "mary",
@@ -607,4 +718,700 @@ BOOST_AUTO_TEST_CASE(singuprewards) try {
 
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE(pet_creation_tolerance) try {
+  monstereosio_tester t{"pet_creation_tolerance"};
+
+  t.create_account("john"_n);
+  t.create_account("mary"_n);
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.produce_blocks();
+
+  // john's newest pet is found through byownercrt, mary has none yet
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                             mvo()("owner", "john")("pet_name", "bobble")),
+               "You can't create another pet now");
+  t.push_action("monstereosio"_n, "createpet"_n, "mary"_n,
+                mvo()("owner", "mary")("pet_name", "mubble"));
+
+  t.produce_block(fc::hours(1));
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bobble"));
+  BOOST_REQUIRE_EQUAL("john", t.get_row("pets"_n, "st_pets", 3)["owner"].as_string());
+
+  // pets created through the index have nothing left to backfill
+  t.push_action("monstereosio"_n, "migrate"_n, "monstereosio"_n,
+                mvo()("table", "pets")("limit", 10));
+  BOOST_REQUIRE(t.get_row("migrations"_n, "st_migration", "pets"_n).is_null());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(entropy_without_seed_row) try {
+  monstereosio_tester t{"entropy_without_seed_row"};
+
+  t.create_account("john"_n);
+  t.create_account("mary"_n);
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.push_action("monstereosio"_n, "createpet"_n, "mary"_n,
+                mvo()("owner", "mary")("pet_name", "mubble"));
+
+  // pet types are rolled from transaction local entropy, no shared seed row
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "seed"_n).empty());
+  BOOST_REQUIRE(!t.get_row("pets"_n, "st_pets", 2).is_null());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(battle_attack_flow) try {
+  monstereosio_tester t{"battle_attack_flow"};
+
+  for (name player : {"john"_n, "mary"_n}) {
+    t.create_account(player);
+    t.push_action("monstereosio"_n, "createpet"_n, player,
+                  mvo()("owner", player)("pet_name", "bubble"));
+  }
+  t.produce_blocks(4);
+
+  for (name player : {"john"_n, "mary"_n}) {
+    uint64_t pet_id = player.value == "john"_n ? 1 : 2;
+    t.push_action("monstereosio"_n, "quickbattle"_n, player,
+                  mvo()("mode", 1)("player", player)("picks", mvo()("pets", std::vector<uint64_t>{pet_id})
+                                                                   ("randoms", std::vector<uint8_t>{})));
+  }
+
+  auto element_of = [&](uint64_t pet_id) {
+    auto type = t.get_row("pets"_n, "st_pets", pet_id)["type"].as_uint64();
+    return t.get_row("pettypes"_n, "st_pet_types", type)["elements"].get_array()[0].as_uint64();
+  };
+
+  // host john plays first, turns alternate until one pet is dead
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "battleattack"_n, "mary"_n,
+                             mvo()("host", "john")("player", "mary")("pet_id", 2)("pet_enemy_id", 1)
+                                  ("element", element_of(2))),
+               "its not your turn");
+  uint32_t turns = 0;
+  while (!t.get_table("monstereosio"_n, "monstereosio"_n, "battles"_n).empty()) {
+    BOOST_REQUIRE(turns++ < 40);
+    bool john = turns % 2 == 1;
+    t.push_action("monstereosio"_n, "battleattack"_n, john ? "john"_n : "mary"_n,
+                  mvo()("host", "john")("player", john ? "john" : "mary")
+                       ("pet_id", john ? 1 : 2)("pet_enemy_id", john ? 2 : 1)
+                       ("element", element_of(john ? 1 : 2)));
+    t.produce_blocks();
+  }
+
+  // the last attacker won, both players and pets left the battle
+  uint64_t winner_pet = turns % 2 == 1 ? 1 : 2;
+  BOOST_REQUIRE_EQUAL(799u, t.get_row("petstats"_n, "st_pet_counters", winner_pet)["experience"].as_uint64());
+  BOOST_REQUIRE_EQUAL(449u, t.get_row("petstats"_n, "st_pet_counters", 3 - winner_pet)["experience"].as_uint64());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "plsinbattles"_n).empty());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "petinbattles"_n).empty());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(attack_matrix) try {
+  monstereosio_tester t{"attack_matrix"};
+
+  auto ratio = [&](uint64_t element_id, uint64_t pet_type_id) {
+    return t.get_row("atkmatrix"_n, "st_attack_ratio", (element_id << 32) | pet_type_id)["ratio"].as_uint64();
+  };
+
+  // 10 elements and 15 pet types were added by the tester, in any order
+  BOOST_REQUIRE_EQUAL(150u, t.get_table("monstereosio"_n, "monstereosio"_n, "atkmatrix"_n).size());
+
+  // pet type 0 has elements 0 and 6, the strongest ratio wins over the default 5
+  BOOST_REQUIRE_EQUAL(8u, ratio(0, 0));
+  BOOST_REQUIRE_EQUAL(10u, ratio(1, 0));
+
+  t.push_action("monstereosio"_n, "changeelemtt"_n, "monstereosio"_n,
+                mvo()("id", 1)("ratios", std::vector<uint8_t>{1,1,1,1,1,1,30,1,1,1}));
+  BOOST_REQUIRE_EQUAL(30u, ratio(1, 0));
+
+  t.push_action("monstereosio"_n, "changepettyp"_n, "monstereosio"_n,
+                mvo()("id", 0)("elements", std::vector<uint8_t>{0}));
+  BOOST_REQUIRE_EQUAL(5u, ratio(1, 0));
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(pet_care_batch) try {
+  monstereosio_tester t{"pet_care_batch"};
+
+  t.create_account("john"_n);
+  t.push_action("monstereosio"_n, "signup"_n, "john"_n, mvo()("user", "john"));
+  t.push_action("monstereosio"_n, "issueitem"_n, "monstereosio"_n,
+                mvo()("player", "john")("item", "2 CANDY")("reason", "test"));
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.produce_block(fc::hours(2));
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bobble"));
+  t.produce_block(fc::hours(4));
+
+  auto care = [&](std::vector<std::pair<uint64_t, uint8_t>> ops) {
+    fc::variants vops;
+    for (auto& op : ops)
+      vops.push_back(mvo()("pet_id", op.first)("op", op.second));
+    t.push_action("monstereosio"_n, "petcarebatch"_n, "john"_n, mvo()("owner", "john")("ops", vops));
+  };
+
+  // both pets are fed with a single candy debit
+  care({{1, 1}, {2, 1}});
+  auto fed_at = t.get_row("petstats"_n, "st_pet_counters", 1)["last_fed_at"].as_uint64();
+  BOOST_REQUIRE_EQUAL(fed_at, t.get_row("petstats"_n, "st_pet_counters", 2)["last_fed_at"].as_uint64());
+  t.produce_block(fc::hours(4));
+  CHECK_ASSERT(care({{1, 1}}), "player has no candy to feed");
+
+  // a failing operation reverts the whole batch
+  t.produce_block(fc::hours(5));
+  CHECK_ASSERT(care({{1, 2}, {1, 2}}), "already sleeping");
+  BOOST_REQUIRE_EQUAL(t.get_row("petstats"_n, "st_pet_counters", 1)["last_bed_at"].as_uint64(),
+                      t.get_row("pets"_n, "st_pets", 1)["created_at"].as_uint64());
+  care({{1, 2}, {2, 2}});
+  BOOST_REQUIRE(t.get_row("petstats"_n, "st_pet_counters", 2)["last_bed_at"].as_uint64() > fed_at);
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(market_escrow) try {
+  monstereosio_tester t{"market_escrow"};
+
+  t.create_account("john"_n);
+  t.create_account("mary"_n);
+  t.deploy_token({"john"_n, "mary"_n});
+
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.produce_blocks();
+
+  // mary escrows a 10 EOS bid plus the 1% market fee
+  t.push_action("monstereosio"_n, "bidpet"_n, "mary"_n,
+                mvo()("pet_id", 1)("bidder", "mary")("amount", "10.0000 EOS")("until", 0));
+  auto bid_id = t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n)[0].primary_key;
+
+  CHECK_ASSERT(t.eos_transfer("mary"_n, "monstereosio"_n, "10.0000 EOS", "mtb" + std::to_string(bid_id)),
+               "transfer must match bid value plus market fees");
+  t.eos_transfer("mary"_n, "monstereosio"_n, "10.1000 EOS", "mtb" + std::to_string(bid_id));
+  BOOST_REQUIRE_EQUAL(asset::from_string("10.1000 EOS"),
+                      t.get_row("bidescrows"_n, "st_bid_escrow", bid_id)["escrow"].as<asset>());
+  t.produce_blocks();
+
+  // an 8 EOS ask settles against it, proceeds and change wait to be claimed
+  t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                mvo()("pet_id", 1)("new_owner", "")("amount", "8.0000 EOS")("until", 0));
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n).empty());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "bidescrows"_n).empty());
+  BOOST_REQUIRE_EQUAL(asset::from_string("1000.0000 EOS"), t.eos_balance("john"_n));
+  BOOST_REQUIRE_EQUAL(asset::from_string("8.0000 EOS"),
+                      t.get_row("refunds"_n, "st_refund", "john"_n)["balance"].as<asset>());
+  BOOST_REQUIRE_EQUAL(asset::from_string("2.0200 EOS"),
+                      t.get_row("refunds"_n, "st_refund", "mary"_n)["balance"].as<asset>());
+
+  t.push_action("monstereosio"_n, "claimrefund"_n, "john"_n, mvo()("owner", "john"));
+  t.push_action("monstereosio"_n, "claimrefund"_n, "mary"_n, mvo()("owner", "mary"));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1008.0000 EOS"), t.eos_balance("john"_n));
+  BOOST_REQUIRE_EQUAL(asset::from_string("991.9200 EOS"), t.eos_balance("mary"_n));
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "refunds"_n).empty());
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "claimrefund"_n, "john"_n, mvo()("owner", "john")),
+               "No refund to claim");
+  t.produce_blocks();
+
+  // refunds give back the deposit, even after a market fee change
+  t.push_action("monstereosio"_n, "bidpet"_n, "john"_n,
+                mvo()("pet_id", 1)("bidder", "john")("amount", "5.0000 EOS")("until", 0));
+  bid_id = t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n)[0].primary_key;
+  t.eos_transfer("john"_n, "monstereosio"_n, "5.0500 EOS", "mtb" + std::to_string(bid_id));
+  t.push_action("monstereosio"_n, "changemktfee"_n, "monstereosio"_n,
+                mvo()("new_fee", 500)("reason", "test"));
+  t.produce_blocks();
+
+  t.push_action("monstereosio"_n, "removebid"_n, "john"_n,
+                mvo()("bidder", "john")("pet_id", 1));
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "bidescrows"_n).empty());
+  t.push_action("monstereosio"_n, "claimrefund"_n, "john"_n, mvo()("owner", "john"));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1008.0000 EOS"), t.eos_balance("john"_n));
+  t.produce_blocks();
+
+  // a direct purchase pays exactly the ask plus the 5% fee
+  t.push_action("monstereosio"_n, "orderask"_n, "mary"_n,
+                mvo()("pet_id", 1)("new_owner", "")("amount", "1.0000 EOS")("until", 0));
+  auto ask_id = t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n)[0].primary_key;
+  CHECK_ASSERT(t.eos_transfer("john"_n, "monstereosio"_n, "1.0499 EOS", "mtt" + std::to_string(ask_id)),
+               "amount is not sufficient to pay for offer's amount and market fees");
+  t.eos_transfer("john"_n, "monstereosio"_n, "1.0500 EOS", "mtt" + std::to_string(ask_id));
+  BOOST_REQUIRE_EQUAL("john", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE_EQUAL(asset::from_string("992.9200 EOS"), t.eos_balance("mary"_n));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1006.9500 EOS"), t.eos_balance("john"_n));
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(transfer_memos) try {
+  monstereosio_tester t{"transfer_memos"};
+
+  t.create_account("john"_n);
+  t.create_account("mary"_n);
+  t.deploy_token({"john"_n, "mary"_n});
+
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                mvo()("pet_id", 1)("new_owner", "")("amount", "1.0000 EOS")("until", 0));
+  auto ask_id = t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n)[0].primary_key;
+  t.produce_blocks();
+
+  // order ids must be plain digits that fit an uint64_t
+  CHECK_ASSERT(t.eos_transfer("mary"_n, "monstereosio"_n, "1.0100 EOS", "mtt"), "invalid number");
+  CHECK_ASSERT(t.eos_transfer("mary"_n, "monstereosio"_n, "1.0100 EOS", "mtt" + std::to_string(ask_id) + "abc"),
+               "invalid number");
+  CHECK_ASSERT(t.eos_transfer("mary"_n, "monstereosio"_n, "1.0100 EOS", "mtt -" + std::to_string(ask_id)),
+               "invalid number");
+  CHECK_ASSERT(t.eos_transfer("mary"_n, "monstereosio"_n, "1.0100 EOS", "mtt99999999999999999999"),
+               "number overflow");
+
+  // ids above 32 bits are no longer truncated onto an existing order
+  CHECK_ASSERT(t.eos_transfer("mary"_n, "monstereosio"_n, "1.0100 EOS",
+                              "mtt" + std::to_string((1ull << 32) + ask_id)),
+               "Invalid order");
+
+  t.eos_transfer("mary"_n, "monstereosio"_n, "1.0100 EOS", "mtt" + std::to_string(ask_id));
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE_EQUAL(asset::from_string("1001.0000 EOS"), t.eos_balance("john"_n));
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(inventory_rows) try {
+  monstereosio_tester t{"inventory_rows"};
+
+  t.create_account("john"_n);
+  t.push_action("monstereosio"_n, "signup"_n, "john"_n, mvo()("user", "john"));
+  auto signup_size = t.items_size("john"_n);
+
+  // a credit opens the item row, spending it erases the row again
+  t.push_action("monstereosio"_n, "issueitem"_n, "monstereosio"_n,
+                mvo()("player", "john")("item", "2 CANDY")("reason", "test"));
+  BOOST_REQUIRE_EQUAL(1u, t.get_table("monstereosio"_n, "john"_n, "inventory"_n).size());
+  BOOST_TEST_MESSAGE( "John Items RAM Size: " << t.items_size("john"_n) );
+
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.produce_block(fc::hours(4));
+  t.push_action("monstereosio"_n, "feedpet"_n, "john"_n, mvo()("pet_id", 1));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1 CANDY"),
+                      t.get_row("inventory"_n, "st_inventory_item", symbol(0, "CANDY").to_symbol_code().value,
+                                "john"_n)["balance"].as<asset>());
+
+  t.produce_block(fc::hours(4));
+  t.push_action("monstereosio"_n, "feedpet"_n, "john"_n, mvo()("pet_id", 1));
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "john"_n, "inventory"_n).empty());
+
+  t.produce_block(fc::hours(4));
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "feedpet"_n, "john"_n, mvo()("pet_id", 1)),
+               "player has no candy to feed");
+  BOOST_REQUIRE_EQUAL(signup_size, t.items_size("john"_n));
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(open_chests) try {
+  monstereosio_tester t{"open_chests"};
+
+  t.create_account("john"_n);
+  t.push_action("monstereosio"_n, "signup"_n, "john"_n, mvo()("user", "john"));
+  t.push_action("monstereosio"_n, "issueitem"_n, "monstereosio"_n,
+                mvo()("player", "john")("item", "3 CHEST")("reason", "test"));
+  t.push_action("monstereosio"_n, "setloottable"_n, "monstereosio"_n,
+                mvo()("id", 0)("entries", fc::variants{
+                  mvo()("symbol", "0,CANDY")("weight", 1)("min_quantity", 1)("max_quantity", 4)}));
+  t.produce_blocks();
+
+  auto chests = [&]() {
+    auto row = t.get_row("inventory"_n, "st_inventory_item", symbol(0, "CHEST").to_symbol_code().value, "john"_n);
+    return row.is_null() ? 0 : row["balance"].as<asset>().get_amount();
+  };
+  auto deferred = [&]() { return t.control->db().get_index<generated_transaction_multi_index>().size(); };
+
+  // two openchests in one transaction schedule their own rewards, chests
+  // are taken right away, the daily chest included
+  auto scheduled = deferred();
+  t.push_actions("john"_n, {{"openchests"_n, mvo()("player", "john")("count", 1)},
+                            {"openchests"_n, mvo()("player", "john")("count", 2)}});
+  BOOST_REQUIRE_EQUAL(scheduled + 2, deferred());
+  BOOST_REQUIRE_EQUAL(1, chests());
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "openchests"_n, "john"_n, mvo()("player", "john")("count", 2)),
+               "player has no chest to open");
+
+  // each chest gives at least a candy
+  t.produce_block(fc::seconds(4));
+  t.produce_blocks();
+  BOOST_REQUIRE_EQUAL(scheduled, deferred());
+  BOOST_REQUIRE(t.get_row("inventory"_n, "st_inventory_item", symbol(0, "CANDY").to_symbol_code().value,
+                          "john"_n)["balance"].as<asset>().get_amount() >= 3);
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(loot_tables) try {
+  monstereosio_tester t{"loot_tables"};
+
+  auto set_table = [&](uint64_t id, fc::variants entries) {
+    t.push_action("monstereosio"_n, "setloottable"_n, "monstereosio"_n, mvo()("id", id)("entries", entries));
+  };
+  auto entry = [](const char* symbol, uint32_t weight, uint32_t min, uint32_t max) {
+    return fc::variant(mvo()("symbol", symbol)("weight", weight)("min_quantity", min)("max_quantity", max));
+  };
+
+  CHECK_ASSERT(set_table(0, {}), "invalid number of loot entries");
+  CHECK_ASSERT(set_table(0, {entry("0,CANDY", 0, 1, 1)}), "loot weight must be positive");
+  CHECK_ASSERT(set_table(0, {entry("0,CANDY", 1, 2, 1)}), "invalid loot quantity range");
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "delloottable"_n, "monstereosio"_n, mvo()("id", 0)),
+               "Invalid loot table");
+
+  t.create_account("john"_n);
+  t.push_action("monstereosio"_n, "signup"_n, "john"_n, mvo()("user", "john"));
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "openchest"_n, "john"_n, mvo()("player", "john")),
+               "loot tables are not set");
+
+  // a single entry slot always drops the same, once per modifier point
+  auto candies = [&]() {
+    auto row = t.get_row("inventory"_n, "st_inventory_item", symbol(0, "CANDY").to_symbol_code().value, "john"_n);
+    return row.is_null() ? 0 : row["balance"].as<asset>().get_amount();
+  };
+  set_table(0, {entry("0,CANDY", 1, 2, 2)});
+  t.push_action("monstereosio"_n, "chestreward"_n, "monstereosio"_n,
+                mvo()("player", "john")("modifier", 3)("reason", "test"));
+  BOOST_REQUIRE_EQUAL(6, candies());
+
+  // an empty drop slot next to it adds nothing
+  set_table(1, {entry("0,CANDY", 1, 0, 0)});
+  t.push_action("monstereosio"_n, "chestrewards"_n, "monstereosio"_n,
+                mvo()("player", "john")("count", 2)("modifier", 1)("reason", "test"));
+  BOOST_REQUIRE_EQUAL(10, candies());
+  BOOST_REQUIRE_EQUAL(2u, t.get_table("monstereosio"_n, "monstereosio"_n, "loottables"_n).size());
+
+  t.push_action("monstereosio"_n, "delloottable"_n, "monstereosio"_n, mvo()("id", 0));
+  t.push_action("monstereosio"_n, "delloottable"_n, "monstereosio"_n, mvo()("id", 1));
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "loottables"_n).empty());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(vitals_energy) try {
+  monstereosio_tester t{"vitals_energy"};
+
+  t.create_account("john"_n);
+  t.push_action("monstereosio"_n, "changecreawk"_n, "monstereosio"_n,
+                mvo()("new_creation_awake", 3600)("reason", "test"));
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.produce_blocks();
+
+  // the pet wakes up an hour from now, it still has its full energy bar
+  t.push_action("monstereosio"_n, "quickbattle"_n, "john"_n,
+                mvo()("mode", 1)("player", "john")("picks", mvo()("pets", std::vector<uint64_t>{1})
+                                                                ("randoms", std::vector<uint8_t>{})));
+  BOOST_REQUIRE(!t.get_row("plsinbattles"_n, "st_pls_inbatt", "john"_n).is_null());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(quickbattle_pairing) try {
+  monstereosio_tester t{"quickbattle_pairing"};
+
+  auto quickbattle = [&](name player, uint64_t pet_id) {
+    t.push_action("monstereosio"_n, "quickbattle"_n, player,
+                  mvo()("mode", 1)("player", player)("picks", mvo()("pets", std::vector<uint64_t>{pet_id})
+                                                                   ("randoms", std::vector<uint8_t>{})));
+  };
+  auto players = [&](name host) {
+    return t.get_row("battles"_n, "st_battle", host)["players_count"].as_uint64();
+  };
+
+  for (name player : {"john"_n, "mary"_n, "peter"_n}) {
+    t.create_account(player);
+    t.push_action("monstereosio"_n, "createpet"_n, player,
+                  mvo()("owner", player)("pet_name", "bubble"));
+  }
+  t.produce_blocks();
+
+  // john waits in the queue with his own lobby
+  quickbattle("john"_n, 1);
+  BOOST_REQUIRE_EQUAL(1u, t.get_table("monstereosio"_n, "monstereosio"_n, "mmqueue"_n).size());
+  BOOST_REQUIRE_EQUAL(1u, players("john"_n));
+
+  // mary takes the waiting lobby of the same mode and bracket
+  quickbattle("mary"_n, 2);
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "mmqueue"_n).empty());
+  BOOST_REQUIRE_EQUAL(2u, players("john"_n));
+  BOOST_REQUIRE(t.get_row("battles"_n, "st_battle", "mary"_n).is_null());
+
+  // the lobby is full, peter opens the next one
+  quickbattle("peter"_n, 3);
+  BOOST_REQUIRE_EQUAL(1u, players("peter"_n));
+  BOOST_REQUIRE(!t.get_row("mmqueue"_n, "st_queue_entry", "peter"_n).is_null());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(battle_sweep) try {
+  monstereosio_tester t{"battle_sweep"};
+
+  uint64_t pet_id = 0;
+  for (name player : {"john"_n, "mary"_n, "peter"_n}) {
+    t.create_account(player);
+    t.push_action("monstereosio"_n, "createpet"_n, player,
+                  mvo()("owner", player)("pet_name", "bubble"));
+  }
+  t.produce_blocks();
+  for (name player : {"john"_n, "mary"_n, "peter"_n}) {
+    t.push_action("monstereosio"_n, "quickbattle"_n, player,
+                  mvo()("mode", 1)("player", player)("picks", mvo()("pets", std::vector<uint64_t>{++pet_id})
+                                                                   ("randoms", std::vector<uint8_t>{})));
+  }
+
+  // john is on turn and never attacks, peter's lobby never fills up
+  t.produce_block(fc::minutes(31));
+  t.push_action("monstereosio"_n, "battlesweep"_n, "monstereosio"_n,
+                mvo()("started_at", 0)("host", "")("limit", 10));
+
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "battles"_n).empty());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "plsinbattles"_n).empty());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "mmqueue"_n).empty());
+  BOOST_REQUIRE_EQUAL(449u, t.get_row("petstats"_n, "st_pet_counters", 1)["experience"].as_uint64());
+  BOOST_REQUIRE_EQUAL(799u, t.get_row("petstats"_n, "st_pet_counters", 2)["experience"].as_uint64());
+
+  // the sweep keeps itself scheduled
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "battlesweep"_n, "monstereosio"_n,
+                             mvo()("started_at", 0)("host", "")("limit", 0)),
+               "invalid sweep limit");
+  BOOST_REQUIRE_EQUAL(1u, t.control->db().get_index<generated_transaction_multi_index>().size());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(battle_membership) try {
+  monstereosio_tester t{"battle_membership"};
+
+  auto quickbattle = [&](name player, uint8_t mode, std::vector<uint64_t> pets) {
+    t.push_action("monstereosio"_n, "quickbattle"_n, player,
+                  mvo()("mode", mode)("player", player)("picks", mvo()("pets", pets)
+                                                                  ("randoms", std::vector<uint8_t>{})));
+  };
+
+  for (name player : {"john"_n, "mary"_n}) {
+    t.create_account(player);
+    t.push_action("monstereosio"_n, "createpet"_n, player,
+                  mvo()("owner", player)("pet_name", "bubble"));
+  }
+  t.produce_blocks();
+
+  // the same pet can't be picked twice
+  CHECK_ASSERT(quickbattle("john"_n, 2, {1, 1}), "pet already in battle");
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "battles"_n).empty());
+
+  // leaving the lobby clears the pet flag, so it can battle again
+  quickbattle("john"_n, 1, {1});
+  t.push_action("monstereosio"_n, "battleleave"_n, "john"_n, mvo()("host", "john")("player", "john"));
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "plsinbattles"_n).empty());
+  t.produce_blocks();
+
+  // players rows keep their battle host
+  quickbattle("john"_n, 1, {1});
+  quickbattle("mary"_n, 1, {2});
+  BOOST_REQUIRE_EQUAL("john", t.get_row("plsinbattles"_n, "st_pls_inbatt", "john"_n)["host"].as_string());
+  BOOST_REQUIRE_EQUAL("john", t.get_row("plsinbattles"_n, "st_pls_inbatt", "mary"_n)["host"].as_string());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(pet_ownership) try {
+  monstereosio_tester t{"pet_ownership"};
+
+  t.create_account("john"_n);
+  t.create_account("mary"_n);
+  t.deploy_token({"john"_n, "mary"_n});
+
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "squirt"));
+  t.produce_blocks();
+
+  // a claimed pet changes owner in place and the claimer is notified
+  t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                mvo()("pet_id", 1)("new_owner", "mary")("amount", "0.0000 EOS")("until", 0));
+  auto trace = t.push_action("monstereosio"_n, "claimpet"_n, "mary"_n,
+                             mvo()("old_owner", "john")("pet_id", 1)("claimer", "mary"));
+  BOOST_REQUIRE(monstereosio_tester::notified(trace, "mary"_n));
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n).empty());
+
+  trace = t.push_action("monstereosio"_n, "transferpet"_n, "mary"_n,
+                        mvo()("pet_id", 1)("new_owner", "john"));
+  BOOST_REQUIRE(monstereosio_tester::notified(trace, "john"_n));
+  BOOST_REQUIRE_EQUAL("john", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  t.produce_blocks();
+
+  // settlements don't notify, a bidder refusing notifications still
+  // receives the pet when an ask matches the escrowed bid
+  t.push_action("monstereosio"_n, "bidpet"_n, "mary"_n,
+                mvo()("pet_id", 2)("bidder", "mary")("amount", "1.0000 EOS")("until", 0));
+  auto bid_id = t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n)[0].primary_key;
+  t.eos_transfer("mary"_n, "monstereosio"_n, "1.0100 EOS", "mtb" + std::to_string(bid_id));
+  t.reject_notifications("mary"_n);
+
+  trace = t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                        mvo()("pet_id", 2)("new_owner", "")("amount", "1.0000 EOS")("until", 0));
+  BOOST_REQUIRE(!monstereosio_tester::notified(trace, "mary"_n));
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 2)["owner"].as_string());
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(rent_sweep) try {
+  monstereosio_tester t{"rent_sweep"};
+
+  t.create_account("john"_n);
+  t.create_account("mary"_n);
+  t.create_account("bob"_n);
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.push_action("monstereosio"_n, "createpet"_n, "bob"_n,
+                mvo()("owner", "bob")("pet_name", "squirt"));
+  t.produce_blocks();
+
+  // john lends his pet to mary for an hour, bob for two
+  uint32_t until = t.control->head_block_time().sec_since_epoch() + 3600;
+  t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                mvo()("pet_id", 1)("new_owner", "mary")("amount", "0.0000 EOS")("until", until));
+  t.push_action("monstereosio"_n, "orderask"_n, "bob"_n,
+                mvo()("pet_id", 2)("new_owner", "mary")("amount", "0.0000 EOS")("until", until + 3600));
+  t.push_action("monstereosio"_n, "claimpet"_n, "mary"_n,
+                mvo()("old_owner", "john")("pet_id", 1)("claimer", "mary"));
+  t.push_action("monstereosio"_n, "claimpet"_n, "mary"_n,
+                mvo()("old_owner", "bob")("pet_id", 2)("claimer", "mary"));
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 2)["owner"].as_string());
+  t.produce_blocks();
+
+  // the rentals are not over yet
+  t.push_action("monstereosio"_n, "rentsweep"_n, "monstereosio"_n, mvo()("limit", 10));
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE_EQUAL(2u, t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n).size());
+
+  t.produce_block(fc::hours(1));
+  t.push_action("monstereosio"_n, "rentsweep"_n, "monstereosio"_n, mvo()("limit", 10));
+  BOOST_REQUIRE_EQUAL("john", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE_EQUAL("mary", t.get_row("pets"_n, "st_pets", 2)["owner"].as_string());
+  BOOST_REQUIRE_EQUAL(1u, t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n).size());
+
+  // returns are not notified, an owner refusing notifications can't hold
+  // up the rentals after theirs; john lends again, ending before bob's
+  t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                mvo()("pet_id", 1)("new_owner", "mary")("amount", "0.0000 EOS")
+                     ("until", t.control->head_block_time().sec_since_epoch() + 60));
+  t.push_action("monstereosio"_n, "claimpet"_n, "mary"_n,
+                mvo()("old_owner", "john")("pet_id", 1)("claimer", "mary"));
+  t.reject_notifications("john"_n);
+
+  t.produce_block(fc::hours(1));
+  t.push_action("monstereosio"_n, "rentsweep"_n, "monstereosio"_n, mvo()("limit", 10));
+  BOOST_REQUIRE_EQUAL("john", t.get_row("pets"_n, "st_pets", 1)["owner"].as_string());
+  BOOST_REQUIRE_EQUAL("bob", t.get_row("pets"_n, "st_pets", 2)["owner"].as_string());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n).empty());
+
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "rentsweep"_n, "monstereosio"_n, mvo()("limit", 0)),
+               "invalid sweep limit");
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(order_sweep) try {
+  monstereosio_tester t{"order_sweep"};
+
+  t.create_account("john"_n);
+  t.create_account("mary"_n);
+  t.create_account("bob"_n);
+  t.deploy_token({"john"_n, "mary"_n, "bob"_n});
+
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.produce_blocks();
+
+  // an ask (order 0) and two escrowed bids (orders 1 and 2) that never meet
+  t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                mvo()("pet_id", 1)("new_owner", "")("amount", "20.0000 EOS")("until", 0));
+  t.push_action("monstereosio"_n, "bidpet"_n, "mary"_n,
+                mvo()("pet_id", 1)("bidder", "mary")("amount", "10.0000 EOS")("until", 0));
+  t.eos_transfer("mary"_n, "monstereosio"_n, "10.1000 EOS", "mtb1");
+  t.push_action("monstereosio"_n, "bidpet"_n, "bob"_n,
+                mvo()("pet_id", 1)("bidder", "bob")("amount", "5.0000 EOS")("until", 0));
+  t.eos_transfer("bob"_n, "monstereosio"_n, "5.0500 EOS", "mtb2");
+  BOOST_REQUIRE_EQUAL(asset::from_string("989.9000 EOS"), t.eos_balance("mary"_n));
+  t.reject_notifications("bob"_n);
+
+  // expired orders can't be paid anymore; no sweep runs yet, the first
+  // one would reschedule itself and collect them while time skips
+  t.produce_block(fc::days(31));
+  BOOST_REQUIRE_EQUAL(3u, t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n).size());
+  CHECK_ASSERT(t.eos_transfer("mary"_n, "monstereosio"_n, "20.2000 EOS", "mtt0"), "order expired");
+
+  // escrows become refunds, bob refusing notifications doesn't stop the
+  // sweep from refunding him and mary
+  t.push_action("monstereosio"_n, "ordersweep"_n, "monstereosio"_n, mvo()("limit", 10));
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "orders"_n).empty());
+  BOOST_REQUIRE(t.get_table("monstereosio"_n, "monstereosio"_n, "bidescrows"_n).empty());
+  BOOST_REQUIRE_EQUAL(asset::from_string("10.1000 EOS"),
+                      t.get_row("refunds"_n, "st_refund", "mary"_n)["balance"].as<asset>());
+  BOOST_REQUIRE_EQUAL(asset::from_string("5.0500 EOS"),
+                      t.get_row("refunds"_n, "st_refund", "bob"_n)["balance"].as<asset>());
+
+  t.push_action("monstereosio"_n, "claimrefund"_n, "mary"_n, mvo()("owner", "mary"));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1000.0000 EOS"), t.eos_balance("mary"_n));
+  BOOST_REQUIRE_EQUAL(asset::from_string("1000.0000 EOS"), t.eos_balance("john"_n));
+
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "ordersweep"_n, "monstereosio"_n, mvo()("limit", 0)),
+               "invalid sweep limit");
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(pet_stats) try {
+  monstereosio_tester t{"pet_stats"};
+
+  t.create_account("john"_n);
+  t.push_action("monstereosio"_n, "createpet"_n, "john"_n,
+                mvo()("owner", "john")("pet_name", "bubble"));
+  t.push_action("monstereosio"_n, "issueitem"_n, "monstereosio"_n,
+                mvo()("player", "john")("item", "1 CANDY")("reason", "test"));
+
+  // createpet writes both rows, the counters fit a fixed 27 byte row
+  auto pet_row = t.get_table_row("monstereosio"_n, "monstereosio"_n, "pets"_n, 1).value;
+  auto stats_row = t.get_table_row("monstereosio"_n, "monstereosio"_n, "petstats"_n, 1).value;
+  BOOST_REQUIRE_EQUAL(27u, stats_row.size());
+  auto created_at = t.get_row("pets"_n, "st_pets", 1)["created_at"].as_uint64();
+  BOOST_REQUIRE_EQUAL(created_at, t.get_row("petstats"_n, "st_pet_counters", 1)["last_fed_at"].as_uint64());
+
+  // care rewrites the counters only
+  t.produce_block(fc::hours(4));
+  t.push_action("monstereosio"_n, "feedpet"_n, "john"_n, mvo()("pet_id", 1));
+  BOOST_REQUIRE(t.get_row("petstats"_n, "st_pet_counters", 1)["last_fed_at"].as_uint64() > created_at);
+  BOOST_REQUIRE(pet_row == t.get_table_row("monstereosio"_n, "monstereosio"_n, "pets"_n, 1).value);
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE(paged_migrate) try {
+  monstereosio_tester t{"paged_migrate"};
+
+  for (name player : {"john"_n, "mary"_n}) {
+    t.create_account(player);
+    t.push_action("monstereosio"_n, "signup"_n, player, mvo()("user", player));
+    t.push_action("monstereosio"_n, "createpet"_n, player,
+                  mvo()("owner", player)("pet_name", "bubble"));
+  }
+  t.produce_blocks();
+  t.push_action("monstereosio"_n, "orderask"_n, "john"_n,
+                mvo()("pet_id", 1)("new_owner", "")("amount", "1.0000 EOS")("until", 0));
+  t.push_action("monstereosio"_n, "orderask"_n, "mary"_n,
+                mvo()("pet_id", 2)("new_owner", "")("amount", "2.0000 EOS")("until", 0));
+  auto ends_at = t.get_row("orders"_n, "st_orders", 0)["ends_at"].as_uint64();
+  t.produce_blocks();
+
+  // one order per run, the cursor resumes from the second one
+  t.push_action("monstereosio"_n, "migrate"_n, "monstereosio"_n, mvo()("table", "orders")("limit", 1));
+  auto cursor = t.get_row("migrations"_n, "st_migration", "orders"_n);
+  BOOST_REQUIRE_EQUAL(1u, cursor["next"].as_uint64());
+  BOOST_REQUIRE_EQUAL(1u, cursor["visited"].as_uint64());
+  BOOST_REQUIRE_EQUAL(0u, cursor["migrated"].as_uint64());
+  BOOST_REQUIRE_EQUAL(ends_at, t.get_row("orders"_n, "st_orders", 0)["ends_at"].as_uint64());
+  t.produce_blocks();
+
+  t.push_action("monstereosio"_n, "migrate"_n, "monstereosio"_n, mvo()("table", "orders")("limit", 1));
+  BOOST_REQUIRE(t.get_row("migrations"_n, "st_migration", "orders"_n).is_null());
+
+  // current pets and signed up players have nothing left to move
+  t.push_action("monstereosio"_n, "migrate"_n, "monstereosio"_n, mvo()("table", "pets")("limit", 10));
+  BOOST_REQUIRE_EQUAL(2u, t.get_table("monstereosio"_n, "monstereosio"_n, "petstats"_n).size());
+  t.push_action("monstereosio"_n, "migrate"_n, "monstereosio"_n, mvo()("table", "accounts2")("limit", 10));
+  BOOST_REQUIRE(t.get_row("migrations"_n, "st_migration", "accounts2"_n).is_null());
+  BOOST_REQUIRE_EQUAL(2u, t.get_table("monstereosio"_n, "monstereosio"_n, "accounts3"_n).size());
+
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "migrate"_n, "monstereosio"_n,
+                             mvo()("table", "battles")("limit", 10)),
+               "E404|no migration for table");
+  CHECK_ASSERT(t.push_action("monstereosio"_n, "migrate"_n, "monstereosio"_n,
+                             mvo()("table", "orders")("limit", 0)),
+               "invalid migration limit");
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,16 @@
+#!/usr/bin/env bash
+
+ROOT_DIR="/opt/eosio/bin"
+cd $ROOT_DIR
+
+# chest loot slots, each chest draws one entry per slot
+
+# slot 0: 1 to 4 candies
+./cleos -u http://eosiodev:8888 push action monstereosio setloottable '{"id": 0, "entries": [{"symbol":"0,CANDY","weight":1,"min_quantity":1,"max_quantity":4}] }' -p monstereosio
+sleep .5
+
+# slot 1: one bonus item, weights out of 10000, the zero candies entry drops nothing
+./cleos -u http://eosiodev:8888 push action monstereosio setloottable '{"id": 1, "entries": [{"symbol":"0,CANDY","weight":5324,"min_quantity":0,"max_quantity":0},{"symbol":"0,ENGYD","weight":500,"min_quantity":1,"max_quantity":1},{"symbol":"0,SHPPT","weight":2000,"min_quantity":1,"max_quantity":1},{"symbol":"0,MHPPT","weight":1000,"min_quantity":1,"max_quantity":1},{"symbol":"0,LHPPT","weight":500,"min_quantity":1,"max_quantity":1},{"symbol":"0,THPPT","weight":100,"min_quantity":1,"max_quantity":1},{"symbol":"0,IATEL","weight":100,"min_quantity":1,"max_quantity":1},{"symbol":"0,SATEL","weight":50,"min_quantity":1,"max_quantity":1},{"symbol":"0,IDFEL","weight":100,"min_quantity":1,"max_quantity":1},{"symbol":"0,SDFEL","weight":50,"min_quantity":1,"max_quantity":1},{"symbol":"0,IHPEL","weight":100,"min_quantity":1,"max_quantity":1},{"symbol":"0,SHPEL","weight":50,"min_quantity":1,"max_quantity":1},{"symbol":"0,BRXSC","weight":50,"min_quantity":1,"max_quantity":1},{"symbol":"0,SVXSC","weight":25,"min_quantity":1,"max_quantity":1},{"symbol":"0,GLXSC","weight":10,"min_quantity":1,"max_quantity":1},{"symbol":"0,SBXSC","weight":25,"min_quantity":1,"max_quantity":1},{"symbol":"0,SSXSC","weight":10,"min_quantity":1,"max_quantity":1},{"symbol":"0,SGXSC","weight":5,"min_quantity":1,"max_quantity":1},{"symbol":"0,REVIV","weight":1,"min_quantity":1,"max_quantity":1}] }' -p monstereosio
+sleep .5
+
+./cleos -u http://eosiodev:8888 get table monstereosio monstereosio loottables
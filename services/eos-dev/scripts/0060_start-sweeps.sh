@@ -0,0 +1,19 @@
+#!/usr/bin/env bash
+
+ROOT_DIR="/opt/eosio/bin"
+cd $ROOT_DIR
+
+# sweeps reschedule themselves as deferred transactions, they only need
+# a first run after the contract is deployed
+
+# battles: idle lobbies and abandoned battles
+./cleos -u http://eosiodev:8888 push action monstereosio battlesweep '{"started_at": 0, "host": "", "limit": 50}' -p monstereosio
+sleep .5
+
+# market: rentals past their end go back to the owners
+./cleos -u http://eosiodev:8888 push action monstereosio rentsweep '{"limit": 50}' -p monstereosio
+sleep .5
+
+# market: asks and bids past ORDER_TTL, escrowed bids become refunds
+./cleos -u http://eosiodev:8888 push action monstereosio ordersweep '{"limit": 50}' -p monstereosio
+sleep .5
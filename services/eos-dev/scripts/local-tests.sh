@@ -20,4 +20,5 @@ cleos push action monstereosio signup '["monsteruserb"]' -p monsteruserb
 cleos push action monstereosio openchest '["monsteruserb"]' -p monsteruserb
 cleos push action monstereosio chestreward '["monsteruserb", 1, "test"]' -p monstereosio
 cleos get account monsteruserb
-cleos get table monstereosio monstereosio accounts2 -L monsteruserb -l 1
\ No newline at end of file
+cleos get table monstereosio monstereosio accounts3 -L monsteruserb -l 1
+cleos get table monstereosio monsteruserb inventory
\ No newline at end of file
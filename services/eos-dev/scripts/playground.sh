@@ -47,4 +47,9 @@ cleos -u http://eosiodev:8888 push action eosio.token transfer '["monsterusera",
 # deploy configs
 cleos -u http://localhost:8830 push action monstereosio changemktfee '[100, "Market fee of 1%"]' -p monstereosio
 cleos -u http://localhost:8830 push action monstereosio changecreawk '[1, "Awake immediately after creation"]' -p monstereosio
-cleos -u http://localhost:8830 push action monstereosio changehungtz '[129601, "Three days of hungerness"]' -p monstereosio
\ No newline at end of file
+cleos -u http://localhost:8830 push action monstereosio changehungtz '[129601, "Three days of hungerness"]' -p monstereosio
+
+# start the sweeps, they reschedule themselves afterwards
+cleos -u http://localhost:8830 push action monstereosio battlesweep '[0, "", 50]' -p monstereosio
+cleos -u http://localhost:8830 push action monstereosio rentsweep '[50]' -p monstereosio
+cleos -u http://localhost:8830 push action monstereosio ordersweep '[50]' -p monstereosio
\ No newline at end of file
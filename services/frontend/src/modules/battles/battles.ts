@@ -76,13 +76,18 @@ export const BATTLE_PHASE_GOING = 3
 export const BATTLE_PHASE_FINISHED = 4
 
 export const parseBattlesFromChain = (data: any): Arena => {
+  // chain battles have fixed size arrays, only the counted slots are in use
+  const commits = data.commits
+    .slice(0, data.players_count)
+    .map((commit: any) => ({ player: commit.player, commitment: "", randoms: [] }))
+
   const battle: Arena = {
     host: data.host,
     mode: data.mode,
     lastMoveAt: data.last_move_at * 1000,
-    petsStats: data.pets_stats,
+    petsStats: data.pets_stats.slice(0, data.pets_count),
     startedAt: data.started_at * 1000,
-    commits: data.commits,
+    commits,
     phase: BATTLE_PHASE_JOINING
   }
 
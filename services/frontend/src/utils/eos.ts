@@ -21,6 +21,7 @@ export const CHAIN_ID = process.env.REACT_APP_CHAIN_ID || "cf057bbfb72640471fd91
 export const EOSIO_TOKEN_ACCOUNT = "eosio.token"
 export const MONSTERS_ACCOUNT = "monstereosio"
 export const MONSTERS_TABLE = "pets"
+export const MONSTERS_STATS_TABLE = "petstats"
 export const BATTLES_TABLE = "battles"
 export const ELEMENTS_TABLE = "elements"
 export const PET_TYPES_TABLE = "pettypes"
@@ -204,13 +205,13 @@ export const loadGlobalConfig = async (store: any) => {
   store.dispatch(loadConfig(config))
 }
 
-export const loadPets = async (id?: number) => {
+const loadPetsRows = async (table: string, id?: number) => {
   const apiList = (lowerBound = 0, limit = 5000): any => {
     return e2DefaultRpc.get_table_rows({
         json: true,
         scope: MONSTERS_ACCOUNT,
         code: MONSTERS_ACCOUNT,
-        table: MONSTERS_TABLE,
+        table,
         lower_bound: lowerBound,
         limit
     }).then(async res => {
@@ -227,6 +228,20 @@ export const loadPets = async (id?: number) => {
   return await apiList(id, id ? 1 : 5000)
 }
 
+// pets hot counters live in petstats, pets without a row keep the
+// counters of their pets row
+export const loadPets = async (id?: number) => {
+  const pets = await loadPetsRows(MONSTERS_TABLE, id)
+  const stats = await loadPetsRows(MONSTERS_STATS_TABLE, id)
+
+  const statsById = stats.reduce((byId: any, stat: any) => {
+    byId[stat.id] = stat
+    return byId
+  }, {})
+
+  return pets.map((pet: any) => ({ ...pet, ...statsById[pet.id] }))
+}
+
 export const loadMonsters = async (
   config: GlobalConfig
 ) => {
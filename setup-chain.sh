@@ -14,7 +14,9 @@ function build_chain() {
         /opt/application/scripts/0000_init-chain.sh && \
         /opt/application/scripts/0010_load-elements.sh && \
         /opt/application/scripts/0020_load-pet-types.sh && \
-        /opt/application/scripts/0030_load-data.sh"
+        /opt/application/scripts/0030_load-data.sh && \
+        /opt/application/scripts/0050_load-loot-tables.sh && \
+        /opt/application/scripts/0060_start-sweeps.sh"
 
 }
 
@@ -32,3 +32,17 @@ if [[ $REPLY =~ ^[Yy]$ ]]
 then
   docker-compose run eosiodev /opt/application/scripts/0030_load-data.sh
 fi
+
+read -p "Load chest loot tables (y/n)? " -n 1 -r
+echo    # (optional) move to a new line
+if [[ $REPLY =~ ^[Yy]$ ]]
+then
+  docker-compose run eosiodev /opt/application/scripts/0050_load-loot-tables.sh
+fi
+
+read -p "Start the sweeps (y/n)? " -n 1 -r
+echo    # (optional) move to a new line
+if [[ $REPLY =~ ^[Yy]$ ]]
+then
+  docker-compose run eosiodev /opt/application/scripts/0060_start-sweeps.sh
+fi